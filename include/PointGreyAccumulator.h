@@ -0,0 +1,105 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYACCUMULATOR_H
+#define POINTGREYACCUMULATOR_H
+
+#include <vector>
+#include "lima/SizeUtils.h"
+#include "PointGreyAtomic.h"
+#include "PointGreyWorkerPool.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class Accumulator
+ * \brief sums N sub-frames into a Bpp32 frame
+ *
+ * Each sub-frame is added straight from the FlyCapture2 image into
+ * the output buffer, the first one of a frame overwrites it, so only
+ * the accumulated frame goes through the Lima buffers. Pixels at or
+ * above the saturation level are counted for every sub-frame.
+ *******************************************************************/
+class Accumulator
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Accumulator", "PointGrey");
+
+public:
+    struct Stats {
+        int nb_frames;                  // accumulated frames
+        int nb_sub_frames;
+        int nb_saturated_sub_frames;    // sub-frames with at least one saturated pixel
+        double nb_saturated_pixels;     // summed over the sub-frames
+        double mean_time;               // s per sub-frame
+    };
+
+    // a Bpp16 sum can not overflow 32 bits below this
+    static const int k_MaxNbSubFrames = 65536;
+
+    Accumulator();
+    ~Accumulator();
+
+    void setNbSubFrames(int nb_sub_frames);
+    int getNbSubFrames() const { return m_nb_sub_frames; }
+    // 0 is the full scale of the sub-frame type
+    void setSaturationLevel(int level);
+    int getSaturationLevel() const { return m_saturation_level; }
+    void setNbThreads(int nb_threads);
+    int getNbThreads() const { return m_pool.getNbThreads(); }
+
+    // restart accumulation for the sub-frame format, to be called before acquisition
+    void prepare(const Size& size, ImageType src_type);
+    // add a sub-frame to dst, true once the frame is complete
+    bool add(const void *src, int src_stride, void *dst);
+    int getNbAccumulated() const { return m_nb_accumulated; }
+    // the next sub-frame starts a new frame
+    bool isFrameStart() const { return !m_nb_accumulated || m_nb_accumulated == m_nb_sub_frames; }
+
+    // current or last completed frame
+    int getNbSaturatedSubFrames() const { return m_nb_saturated_sub_frames; }
+    int getMaxSaturatedPixels() const { return m_max_saturated_pixels; }
+
+    void getStats(Stats& stats);
+
+private:
+    class _Job;
+
+    int m_nb_sub_frames;
+    int m_saturation_level;
+    WorkerPool m_pool;
+
+    Size m_size;
+    ImageType m_src_type;
+    unsigned int m_level;
+    int m_nb_accumulated;
+    int m_nb_saturated_sub_frames;
+    int m_max_saturated_pixels;
+    std::vector<int> m_part_nb_saturated;   // per job part, sized with the pool
+
+    Stats m_stats;                  // acquisition thread copy
+    SeqLock<Stats> m_published_stats;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYACCUMULATOR_H
@@ -0,0 +1,115 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYATOMIC_H
+#define POINTGREYATOMIC_H
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class Atomic
+ * \brief integral, enum or bool value accessed with GCC atomic builtins
+ *
+ * Plain reads, writes and increments are sequentially consistent;
+ * load() and store() take an explicit memory order where a weaker
+ * one is enough.
+ *******************************************************************/
+template <class T>
+class Atomic
+{
+public:
+    explicit Atomic(T value = T()) : m_value(value) {}
+
+    T load(int order = __ATOMIC_SEQ_CST) const
+    { return __atomic_load_n(&m_value, order); }
+    void store(T value, int order = __ATOMIC_SEQ_CST)
+    { __atomic_store_n(&m_value, value, order); }
+    T exchange(T value, int order = __ATOMIC_SEQ_CST)
+    { return __atomic_exchange_n(&m_value, value, order); }
+    // on failure expected is updated with the current value
+    bool compareExchange(T& expected, T desired, int order = __ATOMIC_SEQ_CST)
+    { return __atomic_compare_exchange_n(&m_value, &expected, desired, false,
+                                         order, __ATOMIC_SEQ_CST); }
+    T fetchAdd(T inc, int order = __ATOMIC_SEQ_CST)
+    { return __atomic_fetch_add(&m_value, inc, order); }
+
+    operator T() const { return load(); }
+    Atomic& operator=(T value) { store(value); return *this; }
+    T operator++() { return __atomic_add_fetch(&m_value, 1, __ATOMIC_SEQ_CST); }
+    T operator--() { return __atomic_sub_fetch(&m_value, 1, __ATOMIC_SEQ_CST); }
+    T operator++(int) { return fetchAdd(1); }
+
+private:
+    Atomic(const Atomic&);
+    Atomic& operator=(const Atomic&);
+
+    T m_value;
+};
+
+/*******************************************************************
+ * \class SeqLock
+ * \brief copy of a plain struct published by a single writer
+ *
+ * The writer never waits; a reader retries its copy while the writer
+ * is in the middle of a store, so it never sees a torn value.
+ *******************************************************************/
+template <class T>
+class SeqLock
+{
+public:
+    SeqLock() : m_seq(0), m_value() {}
+
+    void store(const T& value)
+    {
+        unsigned long seq = m_seq;
+        __atomic_store_n(&m_seq, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        m_value = value;
+        __atomic_store_n(&m_seq, seq + 2, __ATOMIC_RELEASE);
+    }
+
+    void load(T& value) const
+    {
+        while (true)
+        {
+            unsigned long seq = __atomic_load_n(&m_seq, __ATOMIC_ACQUIRE);
+            if (seq % 2)
+                continue;
+            value = m_value;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&m_seq, __ATOMIC_RELAXED) == seq)
+                return;
+        }
+    }
+
+private:
+    SeqLock(const SeqLock&);
+    SeqLock& operator=(const SeqLock&);
+
+    unsigned long m_seq;
+    T m_value;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYATOMIC_H
@@ -0,0 +1,135 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYBEAMANALYZER_H
+#define POINTGREYBEAMANALYZER_H
+
+#include <string>
+#include <vector>
+#include "lima/SizeUtils.h"
+#include "PointGreyWorkerPool.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class BeamAnalyzer
+ * \brief beam centroid, RMS width, FWHM and intensity of every frame
+ *
+ * The frame is reduced to its row and column projections in a single
+ * pass, after background subtraction and threshold (pixels below it
+ * count as 0). Positions are in pixels from the center of the first
+ * pixel. Results go to a ring written by the acquisition thread and
+ * read lock-free: each slot is a seqlock, seq is odd while written and
+ * 2 * (index + 1) once complete.
+ *******************************************************************/
+class BeamAnalyzer
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "BeamAnalyzer", "PointGrey");
+
+public:
+    struct Result {
+        int acq_frame_nb;
+        double timestamp;           // host, s since epoch
+        double synced_timestamp;    // camera clock on the host, 0 if unknown
+        double intensity;           // sum after background and threshold
+        double centroid_x;
+        double centroid_y;
+        double rms_x;
+        double rms_y;
+        double fwhm_x;
+        double fwhm_y;
+    };
+
+    struct Stats {
+        int nb_frames;
+        double mean_time;       // s per frame
+        double max_time;        // s
+    };
+
+    // doubles per record of getSeries, in the Result order
+    static const int k_NbFields = 10;
+
+    BeamAnalyzer();
+    ~BeamAnalyzer();
+
+    void setBackgroundMap(const float *map, const Size& size);
+    void clearBackgroundMap();
+    // subtracted where there is no map
+    void setBackgroundLevel(double level);
+    double getBackgroundLevel() const { return m_background_level; }
+    void setThreshold(double threshold);
+    double getThreshold() const { return m_threshold; }
+    void setSeriesSize(int nb_results);
+    int getSeriesSize() const { return m_series_size; }
+    void setNbThreads(int nb_threads) { m_pool.setNbThreads(nb_threads); }
+    int getNbThreads() const { return m_pool.getNbThreads(); }
+
+    // Bpp8, Bpp16 or Bpp32 frames, to be called before acquisition
+    void prepare(const Size& size, ImageType type);
+    void process(const void *src, int src_stride, int acq_frame_nb,
+                 double timestamp, double synced_timestamp);
+
+    // lock-free readers
+    long long getWriteCount() const;
+    bool getResult(long long index, Result& result) const;
+    // false if no frame was analysed yet
+    bool getLastResult(Result& result) const;
+    // up to max_nb results from index first (or the oldest still in the
+    // ring), packed as k_NbFields float64 per result
+    void getSeries(long long first, int max_nb, std::string& data) const;
+
+    void getStats(Stats& stats);
+
+private:
+    class _Job;
+    struct _Slot {
+        long long seq;
+        Result result;
+    };
+
+    static void _profile(const std::vector<double>& proj, double& sum,
+                         double& centroid, double& rms, double& fwhm);
+
+    std::vector<float> m_background_map;
+    Size m_background_size;
+    double m_background_level;
+    double m_threshold;
+    int m_series_size;
+    WorkerPool m_pool;
+
+    Size m_size;
+    ImageType m_type;
+    // background actually used, the level where there is no map
+    std::vector<float> m_background;
+    std::vector<double> m_row_proj;
+    std::vector<std::vector<double> > m_col_proj;
+
+    std::vector<_Slot> m_series;
+    long long m_write_count;
+
+    Stats m_stats;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYBEAMANALYZER_H
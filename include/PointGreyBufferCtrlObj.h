@@ -0,0 +1,154 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYBUFFERCTRLOBJ_H
+#define POINTGREYBUFFERCTRLOBJ_H
+
+#include <vector>
+#include "lima/HwBufferMgr.h"
+#include "lima/ThreadUtils.h"
+#include "PointGreyAtomic.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class HugePageAllocMgr
+ * \brief frame buffer pool backed by huge pages
+ *
+ * The buffers are carved from a single anonymous mapping, using
+ * hugetlbfs pages when the pool has some, transparent huge pages
+ * otherwise. prefault() touches every page and locks the pool so
+ * that the first pass through the ring does not fault.
+ *
+ * Buffers can be pinned while they are viewed outside of Lima; the
+ * pool can then not be reallocated and the acquisition waits before
+ * overwriting them.
+ *******************************************************************/
+class HugePageAllocMgr : public BufferAllocMgr
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "HugePageAllocMgr", "PointGrey");
+
+public:
+    enum PageMode {
+        NormalPages, TransparentHugePages, HugePages2M, HugePages1G
+    };
+
+    struct Info {
+        int page_mode;          // PageMode in use, after fallback
+        double page_size;       // bytes
+        double nb_bytes;        // size of the mapping
+        bool prefaulted;
+        bool locked;
+        double prefault_time;   // s
+    };
+
+    HugePageAllocMgr();
+    virtual ~HugePageAllocMgr();
+
+    void setPageMode(PageMode mode) { m_page_mode = mode; }
+    PageMode getPageMode() const { return m_page_mode; }
+    void setLock(bool lock) { m_lock = lock; }
+    bool getLock() const { return m_lock; }
+
+    virtual void allocBuffers(int nb_buffers, const FrameDim& frame_dim);
+    virtual const FrameDim& getFrameDim();
+    virtual void getNbBuffers(int& nb_buffers);
+    virtual void releaseBuffers();
+    virtual void *getBufferPtr(int buffer_nb);
+
+    // touch every page and lock the pool, once per allocation; a page
+    // mode change reallocates the pool first
+    void prefault();
+    void getInfo(Info& info) const { info = m_info; }
+
+    void pinBuffer(int buffer_nb);
+    void unpinBuffer(int buffer_nb);
+    int getNbPins() const { return m_nb_pins; }
+    // false if the buffer is still pinned after timeout s
+    bool waitUnpinned(int buffer_nb, double timeout);
+
+private:
+    bool _map(PageMode mode, size_t size);
+    void _checkNotPinned();
+    void _release();
+
+    PageMode m_page_mode;
+    bool m_lock;
+
+    FrameDim m_frame_dim;
+    int m_nb_buffers;
+    size_t m_frame_stride;
+    PageMode m_alloc_mode;      // requested mode of the current pool
+    char *m_data;
+    size_t m_size;
+    Info m_info;
+
+    Cond m_pin_cond;
+    std::vector<int> m_pins;
+    Atomic<int> m_nb_pins;
+};
+
+/*******************************************************************
+ * \class BufferCtrlObj
+ * \brief SoftBufferCtrlObj equivalent on top of HugePageAllocMgr
+ *******************************************************************/
+class BufferCtrlObj : public HwBufferCtrlObj
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "BufferCtrlObj", "PointGrey");
+
+public:
+    BufferCtrlObj();
+    virtual ~BufferCtrlObj();
+
+    virtual void setFrameDim(const FrameDim& frame_dim);
+    virtual void getFrameDim(FrameDim& frame_dim);
+
+    virtual void setNbBuffers(int nb_buffers);
+    virtual void getNbBuffers(int& nb_buffers);
+
+    virtual void setNbConcatFrames(int nb_concat_frames);
+    virtual void getNbConcatFrames(int& nb_concat_frames);
+
+    virtual void getMaxNbBuffers(int& max_nb_buffers);
+
+    virtual void *getBufferPtr(int buffer_nb, int concat_frame_nb = 0);
+    virtual void *getFramePtr(int acq_frame_nb);
+
+    virtual void getStartTimestamp(Timestamp& start_ts);
+    virtual void getFrameInfo(int acq_frame_nb, HwFrameInfoType& info);
+
+    virtual void registerFrameCallback(HwFrameCallback& frame_cb);
+    virtual void unregisterFrameCallback(HwFrameCallback& frame_cb);
+
+    StdBufferCbMgr& getBuffer() { return m_cb_mgr; }
+    HugePageAllocMgr& getAllocMgr() { return m_alloc_mgr; }
+
+private:
+    HugePageAllocMgr m_alloc_mgr;
+    StdBufferCbMgr m_cb_mgr;
+    BufferCtrlMgr m_mgr;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYBUFFERCTRLOBJ_H
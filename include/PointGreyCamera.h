@@ -24,22 +24,30 @@
 
 #include <stdlib.h>
 #include <limits>
+#include <map>
+#include <vector>
 #include "lima/HwBufferMgr.h"
 #include "lima/HwMaxImageSizeCallback.h"
 
 #include "FlyCapture2.h"
+#include "PointGreyAccumulator.h"
+#include "PointGreyAtomic.h"
+#include "PointGreyBeamAnalyzer.h"
+#include "PointGreyBufferCtrlObj.h"
+#include "PointGreyClockModel.h"
+#include "PointGreyCompressor.h"
+#include "PointGreyCorrection.h"
+#include "PointGreyDefectMap.h"
+#include "PointGreyFrameHistory.h"
+#include "PointGreyFrameSelector.h"
+#include "PointGreyRecorder.h"
+#include "PointGreyReplay.h"
+#include "PointGreyRoiCounters.h"
+#include "PointGreyShm.h"
+#include "PointGreyStreamer.h"
+#include "PointGreyTracer.h"
 using namespace std;
 
-#ifdef USE_GIGE
-typedef FlyCapture2::GigECamera Camera_t;
-typedef FlyCapture2::GigEImageSettings ImageSettings_t;
-typedef FlyCapture2::GigEImageSettingsInfo ImageSettingsInfo_t;
-#else
-typedef FlyCapture2::Camera Camera_t;
-typedef FlyCapture2::Format7ImageSettings ImageSettings_t;
-typedef FlyCapture2::Format7Info ImageSettingsInfo_t;
-#endif
-
 namespace lima
 {
 namespace PointGrey
@@ -47,6 +55,10 @@ namespace PointGrey
 /*******************************************************************
  * \class Camera
  * \brief object controlling the Point Grey camera via FlyCapture driver
+ *
+ * GigE and Format7 (USB, FireWire) cameras are both supported, the
+ * backend is chosen at connection from the camera interface type.
+ * Image settings are kept in the Format7 layout for both.
  *******************************************************************/
 class Camera : public HwMaxImageSizeCallbackGen
 {
@@ -58,9 +70,82 @@ public:
         Ready, Exposure, Readout, Latency, Fault
     };
 
+    enum DefectMode {
+        DefectMedian, DefectMean
+    };
+
+    enum ReplayPacing {
+        ReplayRecorded, ReplayAsFastAsPossible, ReplayFixedRate
+    };
+
+    enum DriverGrabMode {
+        DriverDropFrames, DriverBufferFrames
+    };
+
+    enum BufferPageMode {
+        BufferNormalPages, BufferTransparentHugePages, BufferHugePages2M, BufferHugePages1G
+    };
+
+    enum StrobeMode {
+        StrobeOff, StrobeExposureActive, StrobeFixedDuration
+    };
+
+    enum StrobePolarity {
+        StrobeActiveLow, StrobeActiveHigh
+    };
+
+    enum GpioDirection {
+        GpioInput, GpioOutput
+    };
+
+    enum PtpStatus {
+        PtpNotSupported, PtpDisabled, PtpEnabled
+    };
+
+    enum CaptureMode {
+        CaptureRetrieve, CaptureCallback
+    };
+
+    enum EventEdge {
+        EventRisingEdge, EventFallingEdge
+    };
+
+    struct FrameMetadata {
+        int acq_frame_nb;
+        int seq_step;       // exposure/gain sequence step, -1 if inactive
+        double exp_time;    // ms, step value when the sequence is active
+        double gain;        // dB, step value when the sequence is active
+        double timestamp;   // host time, s since epoch
+        double camera_timestamp;    // s
+        int frame_counter;  // camera frame counter, -1 if unknown
+        int gpio_state;     // GPIO line states at exposure, bit n for pin n, -1 if unknown
+        double synced_timestamp;    // camera timestamp on the host clock, s since epoch
+        int nb_sub_frames;  // accumulated sub-frames, 1 without accumulation
+        int nb_saturated_sub_frames;    // sub-frames with at least one saturated pixel
+        int max_saturated_pixels;       // saturated pixels in the worst sub-frame
+        int raw_frame_nb;   // frame index before selection
+    };
+
+    struct GrabStats {
+        int nb_frames;          // frames with a latency sample
+        double mean_latency;    // s, from synced_timestamp to publication
+        double max_latency;     // s
+        double frame_cpu_time;  // process cpu s per frame
+        double cpu_load;        // process cpu s per s
+    };
+
+    struct EventStats {
+        int nb_frames;              // seen by the event history
+        int nb_events;
+        int nb_dumped_frames;       // history, event and post frames published
+        int last_event_frame_nb;    // raw_frame_nb of the last event, -1 if none
+    };
+
     Camera(const int camera_serial,
             const int packet_size = -1,
             const int packet_delay = -1);
+    // no hardware, frames are replayed from a recorded sequence
+    Camera(const std::string& replay_file);
     ~Camera();
 
     // hw interface
@@ -70,13 +155,33 @@ public:
 
     void getStatus(Camera::Status& status);
 
+    // event waits, timeouts in s (negative waits forever)
+    void waitForFrame(int acq_frame_nb, double timeout, bool& ready);
+    void waitForStatusChange(Camera::Status status, double timeout, Camera::Status& new_status);
+    // eventfd counting frames and status changes, for poll/select loops
+    void getEventFd(int& fd);
+
     // buffer control object
     HwBufferCtrlObj* getBufferCtrlObj();
 
+    // frame buffer pages, pre-faulted and locked at prepareAcq
+    void getBufferPageMode(BufferPageMode& mode);
+    void setBufferPageMode(BufferPageMode mode);
+    void getBufferLock(bool& lock);
+    void setBufferLock(bool lock);
+    void getBufferAllocInfo(HugePageAllocMgr::Info& info);
+
+    // frame buffer views, the acquisition waits before overwriting a pinned frame
+    void pinFrame(int acq_frame_nb, void *& data, FrameDim& frame_dim);
+    void pinLastFrame(int& acq_frame_nb, void *& data, FrameDim& frame_dim);
+    void unpinFrame(int acq_frame_nb);
+    void getNbPinnedFrames(int& nb_frames);
+
     // detector info object
     void getDetectorType(std::string& type);
     void getDetectorModel(std::string& model);
     void getDetectorImageSize(Size& size);
+    void getInterfaceType(std::string& type);
 
     void getImageType(ImageType& type);
     void setImageType(ImageType type);
@@ -126,6 +231,239 @@ public:
 
     void getAutoFrameRate(bool& auto_frame_rate);
     void setAutoFrameRate(bool auto_frame_rate);
+
+    // driver image queue
+    void getDriverNbBuffers(int& nb_buffers);
+    void setDriverNbBuffers(int nb_buffers);
+    void getDriverGrabMode(DriverGrabMode& mode);
+    void setDriverGrabMode(DriverGrabMode mode);
+    void getDriverGrabTimeout(int& timeout);
+    void setDriverGrabTimeout(int timeout);
+    void getDriverHighPerformanceRetrieve(bool& high_performance);
+    void setDriverHighPerformanceRetrieve(bool high_performance);
+
+    // frames from the acquisition thread (RetrieveBuffer) or the driver callback
+    void getCaptureMode(CaptureMode& mode);
+    void setCaptureMode(CaptureMode mode);
+    void getGrabStats(GrabStats& stats);
+    // warm-up, then one acquisition per capture mode, the Lima buffers must be allocated
+    void runGrabBenchmark(int nb_frames, GrabStats& retrieve_stats, GrabStats& callback_stats);
+
+    // presets, optionally stored in a camera memory channel (1..N)
+    void getNbMemoryChannels(int& nb_channels);
+    void savePreset(const std::string& name, int channel = 0);
+    void recallPreset(const std::string& name, bool host_only = false);
+    void removePreset(const std::string& name);
+    void getNbPresets(int& nb_presets);
+    void getPresetName(int index, std::string& name);
+    void getPresetSwitchTime(double& switch_time);
+
+    // strobe outputs and GPIO lines, delay and duration in ms
+    void getNbGpioPins(int& nb_pins);
+    void getStrobe(int pin, StrobeMode& mode, StrobePolarity& polarity,
+                   double& delay, double& duration);
+    void setStrobe(int pin, StrobeMode mode, StrobePolarity polarity,
+                   double delay = 0., double duration = 0.);
+    void getStrobeRange(int pin, double& min_value, double& max_value);
+    void getGpioDirection(int pin, GpioDirection& direction);
+    void setGpioDirection(int pin, GpioDirection direction);
+    void getGpioMetadataActive(bool& active);
+    void setGpioMetadataActive(bool active);
+
+    // IEEE 1588 on GigE cameras, and camera to host clock model
+    void getPtpStatus(PtpStatus& status);
+    void setPtpActive(bool active);
+    void getClockModelWindow(int& nb_samples);
+    void setClockModelWindow(int nb_samples);
+    void getClockModelSampleInterval(double& interval);
+    void setClockModelSampleInterval(double interval);
+    void getClockModelStats(ClockModel::Stats& stats);
+    void resetClockModel();
+
+    // exposure/gain sequencer
+    void clearExpGainSequence();
+    void addExpGainStep(double exp_time, double gain);
+    void getNbExpGainSteps(int& nb_steps);
+    void getExpGainStep(int step, double& exp_time, double& gain);
+    void getExpGainSequenceActive(bool& active);
+    void setExpGainSequenceActive(bool active);
+    void getExpGainSequenceOnDevice(bool& on_device);
+
+    // dark/flat-field correction
+    void setDarkMap(const float *map, const Size& size);
+    void clearDarkMap();
+    void setGainMap(const float *map, const Size& size);
+    void clearGainMap();
+    void getCorrectionActive(bool& active);
+    void setCorrectionActive(bool active);
+    void getCorrectionImageType(ImageType& type);
+    void setCorrectionImageType(ImageType type);
+    void getCorrectionNbThreads(int& nb_threads);
+    void setCorrectionNbThreads(int nb_threads);
+
+    // sub-frames summed in the acquisition thread, published as Bpp32
+    void getAccumulationActive(bool& active);
+    void setAccumulationActive(bool active);
+    void getAccumulationNbSubFrames(int& nb_sub_frames);
+    void setAccumulationNbSubFrames(int nb_sub_frames);
+    void getAccumulationSaturationLevel(int& level);
+    void setAccumulationSaturationLevel(int level);
+    void getAccumulationNbThreads(int& nb_threads);
+    void setAccumulationNbThreads(int nb_threads);
+    void getAccumulationStats(Accumulator::Stats& stats);
+
+    // beam centroid and profile of every frame, results indexed by acq_frame_nb
+    void getBeamAnalysisActive(bool& active);
+    void setBeamAnalysisActive(bool active);
+    void setBeamBackgroundMap(const float *map, const Size& size);
+    void clearBeamBackgroundMap();
+    void getBeamBackgroundLevel(double& level);
+    void setBeamBackgroundLevel(double level);
+    void getBeamThreshold(double& threshold);
+    void setBeamThreshold(double threshold);
+    void getBeamAnalysisNbThreads(int& nb_threads);
+    void setBeamAnalysisNbThreads(int nb_threads);
+    void getBeamSeriesSize(int& nb_results);
+    void setBeamSeriesSize(int nb_results);
+    void getBeamResult(int acq_frame_nb, BeamAnalyzer::Result& result);
+    void getLastBeamResult(BeamAnalyzer::Result& result);
+    // results from first_frame_nb, BeamAnalyzer::k_NbFields float64 each
+    void getBeamSeries(int first_frame_nb, int max_nb, std::string& data);
+    void getBeamAnalysisStats(BeamAnalyzer::Stats& stats);
+
+    // sum, mean, min and max over regions of every frame, records indexed by acq_frame_nb
+    void getRoiCountersActive(bool& active);
+    void setRoiCountersActive(bool active);
+    void clearRoiCounters();
+    void addRoiCounter(const Roi& roi, int& index);
+    void getNbRoiCounters(int& nb_rois);
+    void getRoiCounter(int index, Roi& roi);
+    void getRoiCounterSeriesSize(int& nb_records);
+    void setRoiCounterSeriesSize(int nb_records);
+    void getRoiCounterValues(int acq_frame_nb, int index,
+                             double& sum, double& mean, double& min_value, double& max_value);
+    // records from first_frame_nb: acq_frame_nb, timestamp, then sum, mean, min, max per region
+    void getRoiCounterSeries(int first_frame_nb, int max_nb, std::string& data);
+    void getRoiCounterStats(RoiCounters::Stats& stats);
+
+    // data reduction: only frames meeting the criterion are published, with context
+    void getSelectionActive(bool& active);
+    void setSelectionActive(bool active);
+    void getSelectionCriterion(FrameSelector::Criterion& criterion);
+    void setSelectionCriterion(FrameSelector::Criterion criterion);
+    void getSelectionThreshold(double& threshold);
+    void setSelectionThreshold(double threshold);
+    void getSelectionRegion(Roi& region);
+    void setSelectionRegion(const Roi& region);
+    void getSelectionNbPreFrames(int& nb_frames);
+    void setSelectionNbPreFrames(int nb_frames);
+    void getSelectionNbPostFrames(int& nb_frames);
+    void setSelectionNbPostFrames(int nb_frames);
+    void getSelectionStats(FrameSelector::Stats& stats);
+
+    // pre-trigger history: frames are only kept until a software or GPIO event,
+    // which publishes them (to disk if the recorder is active) with post frames
+    void getEventHistoryActive(bool& active);
+    void setEventHistoryActive(bool active);
+    void getEventNbPreFrames(int& nb_frames);
+    void setEventNbPreFrames(int nb_frames);
+    void getEventNbPostFrames(int& nb_frames);
+    void setEventNbPostFrames(int nb_frames);
+    void getEventGpioPin(int& pin);
+    void setEventGpioPin(int pin);
+    void getEventGpioEdge(EventEdge& edge);
+    void setEventGpioEdge(EventEdge edge);
+    void triggerEvent();
+    void getEventStats(EventStats& stats);
+
+    // off: frames are analysed but skip the Lima buffers and the publishers
+    void getFramePublishActive(bool& active);
+    void setFramePublishActive(bool active);
+
+    // defective pixel correction
+    void clearDefectMap();
+    void addDefectPixel(int x, int y);
+    void setDefectMask(const unsigned char *mask, const Size& size);
+    void getNbDefectPixels(int& nb_pixels);
+    void getDefectCorrectionActive(bool& active);
+    void setDefectCorrectionActive(bool active);
+    void getDefectCorrectionMode(DefectMode& mode);
+    void setDefectCorrectionMode(DefectMode mode);
+    void buildDefectMap(int nb_frames, double nb_sigma);
+    void getDefectMapBuilding(bool& building);
+
+    // compression side channel
+    void getCompressionActive(bool& active);
+    void setCompressionActive(bool active);
+    void getCompressionNbThreads(int& nb_threads);
+    void setCompressionNbThreads(int nb_threads);
+    void getCompressionChunkSize(int& chunk_size);
+    void setCompressionChunkSize(int chunk_size);
+    void getCompressionRingSize(int& nb_frames);
+    void setCompressionRingSize(int nb_frames);
+    void getCompressedFrame(int acq_frame_nb, std::string& data);
+    void getCompressedFrameSize(int acq_frame_nb, int& size);
+    void getCompressionStats(Compressor::Stats& stats);
+    static void decompressFrame(const std::string& data, std::string& raw);
+
+    // direct-to-disk recorder, raw frames bypass the Lima buffers
+    void getRecorderActive(bool& active);
+    void setRecorderActive(bool active);
+    void getRecorderFileName(std::string& file_name);
+    void setRecorderFileName(const std::string& file_name);
+    void getRecorderNbBuffers(int& nb_buffers);
+    void setRecorderNbBuffers(int nb_buffers);
+    void getRecorderBufferSize(int& nb_frames);
+    void setRecorderBufferSize(int nb_frames);
+    void getRecorderStats(Recorder::Stats& stats);
+
+    // published frames copied to a shared memory ring for other processes
+    void getShmActive(bool& active);
+    void setShmActive(bool active);
+    void getShmName(std::string& name);
+    void setShmName(const std::string& name);
+    void getShmNbSlots(int& nb_slots);
+    void setShmNbSlots(int nb_slots);
+    void getShmStats(ShmPublisher::Stats& stats);
+
+    // TCP streaming of published frames to remote viewers
+    void getStreamActive(bool& active);
+    void setStreamActive(bool active);
+    void getStreamPort(int& port);
+    void setStreamPort(int port);
+    void getStreamDecimation(int& decimation);
+    void setStreamDecimation(int decimation);
+    void getStreamCompression(bool& compression);
+    void setStreamCompression(bool compression);
+    void getStreamQueueDepth(int& nb_frames);
+    void setStreamQueueDepth(int nb_frames);
+    void getStreamNbClients(int& nb_clients);
+    void getStreamClientStats(int client, Streamer::ClientStats& stats);
+
+    // replay of a recorded sequence through the acquisition thread
+    void getReplayFile(std::string& file_name);
+    void setReplayFile(const std::string& file_name);
+    void getReplayActive(bool& active);
+    void setReplayActive(bool active);
+    void getReplayPacing(ReplayPacing& pacing);
+    void setReplayPacing(ReplayPacing pacing);
+    void getReplayFrameRate(double& frame_rate);
+    void setReplayFrameRate(double frame_rate);
+    void getReplayLoop(bool& loop);
+    void setReplayLoop(bool loop);
+    void getReplayNbFrames(int& nb_frames);
+
+    // event trace of the frame stages and control calls, Chrome trace JSON
+    void getTraceActive(bool& active);
+    void setTraceActive(bool active);
+    void getTraceBufferSize(int& nb_events);
+    void setTraceBufferSize(int nb_events);
+    void clearTrace();
+    void dumpTrace(const std::string& file_name);
+    void getTraceStats(Tracer::Stats& stats);
+
+    // per-frame metadata, valid while the frame is in the buffer ring
+    void getFrameMetadata(int acq_frame_nb, FrameMetadata& metadata);
 protected:
     // property management
     void _getPropertyValue(FlyCapture2::PropertyType type, double& value);
@@ -136,32 +474,203 @@ protected:
 
     void _getImageSettingsInfo();
     void _applyImageSettings();
+    void _applyConfiguration(const FlyCapture2::FC2Config& config);
+    void _readImageSettings();
+    void _restoreProperty(FlyCapture2::PropertyType type, double value, bool auto_mode);
+    void _checkGpioPin(int pin);
+    void _applyEmbeddedImageInfo();
 private:
     class _AcqThread;
     friend class _AcqThread;
 
+    struct _SeqStep {
+        double exp_time;
+        double gain;
+        unsigned int raw_shutter;   // register values, matched against the
+        unsigned int raw_gain;      // embedded ones to tag the frames
+    };
+
+    struct _RawFrame {
+        const void *data;
+        int stride;
+        ImageType type;
+        double timestamp;
+        double camera_timestamp;
+        int frame_counter;
+        int gpio_state;
+        int seq_step;       // step the frame was exposed with, -1 if unknown
+        int frame_nb;       // set by _processFrame
+        int nb_saturated_sub_frames;
+        int max_saturated_pixels;
+    };
+
+    // host-side snapshot of a preset
+    struct _Preset {
+        int channel;            // camera memory channel, 0 if host only
+        FlyCapture2::Format7ImageSettings image_settings;
+        FlyCapture2::FC2Config config;
+        TrigMode trig_mode;
+        double exp_time;
+        double gain;
+        double frame_rate;
+        bool auto_exp_time;
+        bool auto_gain;
+        bool auto_frame_rate;
+        bool seq_active;
+        bool correction_active;
+        ImageType correction_type;
+        bool defect_active;
+        DefectMode defect_mode;
+        bool compression_active;
+    };
+
+    // property emulation when no camera is connected
+    struct _SimProperty {
+        double value;
+        double min_value;
+        double max_value;
+        bool auto_mode;
+    };
+
     void _setStatus(Camera::Status status, bool force);
+    void _notifyEvent();
     void _stopAcq(bool internalFlag);
     void _forcePGRY16Mode();
+    void _getSensorImageType(ImageType& type);
+    void _imageTypeChanged();
+    bool _processImage(FlyCapture2::Image& image);
+    static void _imageCallback(FlyCapture2::Image *image, const void *data);
+    bool _processReplayFrame();
+    bool _processFrame(const _RawFrame& frame);
+    bool _selectFrame(const _RawFrame& frame);
+    bool _eventFrame(const _RawFrame& frame);
+    bool _dumpHistory(FrameHistory& history, const _RawFrame& frame);
+    bool _publishFrame(const _RawFrame& frame);
+    bool _isAcqComplete() const;
+    void _init();
+    static void _pushHistory(FrameHistory& history, const _RawFrame& frame, bool append = false);
+    static void _getHistoryFrame(const FrameHistory& history, int index, _RawFrame& frame);
+    bool _tryPinFrame(int acq_frame_nb, void *& data, FrameDim& frame_dim);
+    bool _waitFrameUnpinned();
+    void _finishAcq();
+    double _getCameraTimestamp(const FlyCapture2::Image& image);
+    int _getSeqStep(const FlyCapture2::Image *image, int frame_counter);
+    static int _getGpioState(const FlyCapture2::Image& image);
+    static double _getProcessCpuTime();
+    void _updateGrabStats(double synced_timestamp);
+    void _runBenchmarkAcq(CaptureMode mode, int nb_frames, GrabStats& stats);
+
+    void _prepareExpGainSequence();
+    bool _programDeviceSequence();
+    void _disableDeviceSequence();
+    bool _advanceExpGainSequence(int frame_nb);
+    unsigned int _getRawPropertyValue(FlyCapture2::PropertyType type, double value);
+    _SimProperty& _getSimProperty(FlyCapture2::PropertyType type);
 
-    SoftBufferCtrlObj m_buffer_ctrl_obj;
+    BufferCtrlObj m_buffer_ctrl_obj;
 
-    Camera::Status m_status;
+    // lock-free, read by pollers while the acquisition thread updates them
+    Atomic<Camera::Status> m_status;
     int m_nb_frames;
-    int m_image_number;
+    Atomic<int> m_image_number;
 
     _AcqThread *m_acq_thread;
     Cond m_cond;
-    volatile bool m_quit;
-    volatile bool m_acq_started;
-    volatile bool m_thread_running;
 
-    Camera_t *m_camera;
+    Cond m_event_cond;
+    Atomic<int> m_nb_event_waiters;
+    Atomic<int> m_event_fd;
+    Atomic<bool> m_quit;
+    Atomic<bool> m_acq_started;
+    Atomic<bool> m_thread_running;
+
+    FlyCapture2::CameraBase *m_camera;
+    // the concrete camera, exactly one is set when a camera is connected
+    FlyCapture2::Camera *m_format7_camera;
+    FlyCapture2::GigECamera *m_gige_camera;
     FlyCapture2::CameraInfo m_camera_info;
+    FlyCapture2::FC2Config m_config;
+    CaptureMode m_capture_mode;
+    Atomic<bool> m_callback_active;
+    Atomic<int> m_nb_running_callbacks;
+    GrabStats m_grab_stats;
+    double m_grab_start_time;
+    double m_grab_start_cpu_time;
     FlyCapture2::Error m_error;
 
-    ImageSettingsInfo_t m_image_settings_info;
-    ImageSettings_t m_image_settings;
+    FlyCapture2::Format7Info m_image_settings_info;
+    FlyCapture2::Format7ImageSettings m_image_settings;
+
+    std::map<std::string, _Preset> m_presets;
+    double m_preset_switch_time;
+
+    bool m_gpio_metadata_active;
+    bool m_frame_counter_active;
+    bool m_embedded_timestamp_active;
+    double m_cycle_time_base;
+    double m_last_cycle_time;
+    ClockModel m_clock_model;
+
+    std::vector<_SeqStep> m_seq_steps;
+    bool m_seq_active;
+    bool m_seq_on_device;
+    bool m_embedded_settings_active;
+    bool m_seq_counter_started;
+    unsigned int m_seq_counter_origin;
+
+    std::vector<FrameMetadata> m_frame_metadata;
+
+    Correction m_correction;
+    bool m_correction_active;
+
+    Accumulator m_accumulator;
+    bool m_accumulation_active;
+    // first sub-frame of the frame being accumulated, data not kept
+    _RawFrame m_accumulation_first;
+
+    BeamAnalyzer m_beam_analyzer;
+    bool m_beam_active;
+
+    RoiCounters m_roi_counters;
+    bool m_roi_counters_active;
+
+    FrameSelector m_frame_selector;
+    FrameHistory m_selection_history;
+    bool m_selection_active;
+
+    FrameHistory m_event_history;
+    bool m_event_active;
+    int m_event_nb_post_frames;
+    int m_event_gpio_pin;
+    EventEdge m_event_gpio_edge;
+    int m_event_gpio_level;     // last pin level, -1 if unknown
+    int m_event_post_left;
+    Atomic<bool> m_event_pending;
+    EventStats m_event_stats;           // acquisition thread copy
+    SeqLock<EventStats> m_published_event_stats;
+
+    int m_raw_frame_nb;
+    bool m_frame_publish_active;
+
+    DefectMap m_defect_map;
+    bool m_defect_active;
+
+    Compressor m_compressor;
+    bool m_compression_active;
+
+    Recorder m_recorder;
+    bool m_recorder_active;
+
+    ShmPublisher m_shm_publisher;
+    bool m_shm_active;
+
+    Streamer m_streamer;
+
+    Replay m_replay;
+    bool m_replay_active;
+
+    Tracer m_tracer;
+    std::map<FlyCapture2::PropertyType, _SimProperty> m_sim_properties;
 };
 } // namespace PointGrey
 } // namespace lima
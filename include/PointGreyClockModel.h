@@ -0,0 +1,129 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYCLOCKMODEL_H
+#define POINTGREYCLOCKMODEL_H
+
+#include <vector>
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class ClockModel
+ * \brief online offset/drift model from camera to host time
+ *
+ * A line host = offset + rate * camera is least-squares fitted on a
+ * sliding window of (camera, host) timestamp pairs, taken at most
+ * every sample interval so that the window spans enough time for the
+ * drift. A sample far off the line (camera clock reset, PTP step)
+ * restarts the model.
+ *
+ * The fitted line is published as a seqlock snapshot: convert() and
+ * the samples falling between two sample intervals never take the
+ * lock, which is only held to add a sample and refit.
+ *******************************************************************/
+class ClockModel
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "ClockModel", "PointGrey");
+
+public:
+    struct Stats {
+        int nb_samples;
+        int nb_resets;
+        double offset;          // host - camera at the last sample, s
+        double drift;           // camera clock rate error, ppm
+        double jitter;          // rms residual, s
+    };
+
+    ClockModel();
+
+    void setWindow(int nb_samples);
+    int getWindow() const { return m_window; }
+    void setSampleInterval(double interval);
+    double getSampleInterval() const { return m_sample_interval; }
+    void setResetThreshold(double threshold);
+    double getResetThreshold() const { return m_reset_threshold; }
+    // a frozen model ignores new samples, for measurements against a fixed line
+    void setFrozen(bool frozen) { m_frozen = frozen; }
+    bool getFrozen() const { return m_frozen; }
+
+    void reset();
+    void addSample(double camera_time, double host_time);
+    // host time of a camera timestamp, false until a sample was added
+    bool convert(double camera_time, double& host_time);
+    void getStats(Stats& stats);
+
+private:
+    struct _Sample {
+        double camera;
+        double host;
+    };
+
+    struct _Snapshot {
+        int nb_samples;
+        double camera_origin;
+        double host_origin;
+        double intercept;
+        double rate;
+        double last_camera;
+        double sample_interval;
+        double reset_threshold;
+    };
+
+    void _clear();
+    void _fit();
+    void _publish();
+    void _readSnapshot(_Snapshot& snapshot) const;
+    double _predict(double camera) const
+    { return m_host_origin + m_intercept + m_rate * (camera - m_camera_origin); }
+    static double _predict(const _Snapshot& snapshot, double camera)
+    { return snapshot.host_origin + snapshot.intercept +
+             snapshot.rate * (camera - snapshot.camera_origin); }
+
+    Mutex m_lock;
+    int m_window;
+    double m_sample_interval;
+    double m_reset_threshold;
+    bool m_frozen;
+
+    // samples relative to the origins, ring of m_window
+    std::vector<_Sample> m_samples;
+    int m_next;
+    double m_camera_origin;
+    double m_host_origin;
+    double m_last_camera;
+
+    double m_intercept;
+    double m_rate;
+    double m_jitter;
+    int m_nb_resets;
+
+    // odd while the snapshot is written
+    unsigned long m_snapshot_seq;
+    _Snapshot m_snapshot;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYCLOCKMODEL_H
@@ -0,0 +1,125 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYCOMPRESSOR_H
+#define POINTGREYCOMPRESSOR_H
+
+#include <string>
+#include <vector>
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "PointGreyWorkerPool.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class Compressor
+ * \brief lossless frame compression into a ring of compressed frames
+ *
+ * Frames are cut in chunks, each chunk is byte-shuffled by pixel
+ * depth then compressed as a standard LZ4 block. Chunks are shared
+ * by the worker pool. A compressed frame is laid out as:
+ *   uint32 raw size, uint32 element size, uint32 nb chunks,
+ *   uint32 chunk size, uint32 compressed size of each chunk
+ *   (bit 31 set when the chunk is stored uncompressed), chunk data.
+ *
+ * process() returns once the frame is compressed: it runs in the
+ * acquisition thread before the frame is published, so its time adds
+ * to the per-frame cost and must stay below the frame period. Slots
+ * are seqlocks, seq being odd while the slot is written.
+ *******************************************************************/
+class Compressor
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Compressor", "PointGrey");
+
+public:
+    struct Stats {
+        int nb_frames;
+        double raw_bytes;
+        double compressed_bytes;
+        double ratio;           // raw / compressed
+        double mean_time;       // s per frame
+        double max_time;        // s
+    };
+
+    Compressor();
+    ~Compressor();
+
+    void setNbThreads(int nb_threads) { m_pool.setNbThreads(nb_threads); }
+    int getNbThreads() const { return m_pool.getNbThreads(); }
+    void setChunkSize(int chunk_size);
+    int getChunkSize() const { return m_chunk_size; }
+    void setRingSize(int nb_frames);
+    int getRingSize() const { return m_ring_size; }
+
+    // allocate the ring for the frame dimension, to be called before acquisition
+    void prepare(const FrameDim& frame_dim);
+    void process(int acq_frame_nb, const void *frame);
+
+    // copy of a compressed frame, if still in the ring
+    void getFrame(int acq_frame_nb, std::string& data);
+    int getFrameSize(int acq_frame_nb);
+    void getStats(Stats& stats);
+
+    static void decompress(const void *src, int src_size, std::string& raw);
+
+    // LZ4 block format primitives, lz4Compress needs a k_LZ4HashSize table
+    static const int k_LZ4HashSize = 1 << 12;
+    static int lz4Bound(int size) { return size + size / 255 + 16; }
+    static int lz4Compress(const unsigned char *src, int src_size,
+                           unsigned char *dst, unsigned int *hash_table);
+    static int lz4Decompress(const unsigned char *src, int src_size,
+                             unsigned char *dst, int dst_capacity);
+
+private:
+    class _Job;
+    struct _Slot {
+        long long seq;          // 2 * (acq_frame_nb + 1) once written
+        int size;
+    };
+
+    int _getSlot(int acq_frame_nb, int& size);
+    bool _checkSlot(int slot_nb, int acq_frame_nb) const;
+
+    WorkerPool m_pool;
+    int m_chunk_size;
+    int m_ring_size;
+
+    int m_raw_size;
+    int m_element_size;
+    int m_nb_chunks;
+    int m_slot_capacity;
+    std::vector<unsigned char> m_ring;
+    std::vector<_Slot> m_slots;
+
+    // per worker scratch: shuffled chunk and hash table
+    std::vector<std::vector<unsigned char> > m_shuffle;
+    std::vector<std::vector<unsigned int> > m_hash;
+
+    Mutex m_stats_lock;
+    Stats m_stats;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYCOMPRESSOR_H
@@ -0,0 +1,84 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYCORRECTION_H
+#define POINTGREYCORRECTION_H
+
+#include <vector>
+#include "lima/SizeUtils.h"
+#include "PointGreyWorkerPool.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class Correction
+ * \brief fused dark/flat-field correction: out = (raw - dark) * gain
+ *
+ * Applied while copying the frame out of the FlyCapture2 image, so the
+ * corrected frame is written in a single pass. Rows are split across
+ * the worker pool for large sensors.
+ *******************************************************************/
+class Correction
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Correction", "PointGrey");
+
+public:
+    Correction();
+    ~Correction();
+
+    void setDarkMap(const float *map, const Size& size);
+    void clearDarkMap();
+    void setGainMap(const float *map, const Size& size);
+    void clearGainMap();
+
+    // Bpp32F or Bpp16 (clamped)
+    void setOutputImageType(ImageType type);
+    ImageType getOutputImageType() const { return m_output_type; }
+
+    void setNbThreads(int nb_threads) { m_pool.setNbThreads(nb_threads); }
+    int getNbThreads() const { return m_pool.getNbThreads(); }
+
+    // check the maps against the frame size, to be called before acquisition
+    void prepare(const Size& size);
+    void process(const void *src, int src_stride, ImageType src_type, void *dst);
+
+private:
+    class _Job;
+
+    std::vector<float> m_dark_map;
+    Size m_dark_size;
+    std::vector<float> m_gain_map;
+    Size m_gain_size;
+
+    // maps actually used, defaulted to 0 and 1 when not loaded
+    std::vector<float> m_dark;
+    std::vector<float> m_gain;
+    Size m_size;
+
+    ImageType m_output_type;
+    WorkerPool m_pool;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYCORRECTION_H
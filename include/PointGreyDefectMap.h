@@ -0,0 +1,97 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYDEFECTMAP_H
+#define POINTGREYDEFECTMAP_H
+
+#include <vector>
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "PointGreyAtomic.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class DefectMap
+ * \brief defective pixel list and its correction
+ *
+ * Defects are kept as a sorted list of pixel indexes with, for each
+ * of them, the precomputed list of its valid neighbours. Correcting
+ * a frame thus only touches the defects and their neighbourhood.
+ *
+ * A build only sums the dark frames in the acquisition thread; the
+ * defects are extracted afterwards by the next prepare() or
+ * getNbPixels(), out of the frame path.
+ *******************************************************************/
+class DefectMap
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "DefectMap", "PointGrey");
+
+public:
+    enum Mode {
+        Median, Mean
+    };
+
+    DefectMap();
+
+    void clear();
+    void addPixel(int x, int y);
+    void setMask(const unsigned char *mask, const Size& size);
+    int getNbPixels();
+
+    void setMode(Mode mode) { m_mode = mode; }
+    Mode getMode() const { return m_mode; }
+
+    // flag the pixels of the mean of the next nb_frames dark frames
+    // deviating from the median by more than nb_sigma
+    void startBuild(int nb_frames, double nb_sigma);
+    bool isBuilding() const { return m_build_nb_frames > 0; }
+
+    // build the index for the frame size, to be called before acquisition
+    void prepare(const Size& size);
+    void process(void *frame, ImageType type);
+
+private:
+    template <class T> void _correct(T *frame);
+    template <class T> void _accumulate(const T *frame);
+    void _finishBuild();
+
+    Mutex m_lock;
+    std::vector<Point> m_pixels;
+    Mode m_mode;
+    Size m_size;
+
+    std::vector<unsigned int> m_index;
+    std::vector<unsigned int> m_neighbours;
+    std::vector<unsigned int> m_neighbour_begin;
+
+    Atomic<int> m_build_nb_frames;
+    Atomic<bool> m_build_done;      // frames summed, defects not extracted yet
+    int m_build_count;
+    double m_build_nb_sigma;
+    std::vector<double> m_build_sum;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYDEFECTMAP_H
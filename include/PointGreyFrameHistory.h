@@ -0,0 +1,90 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYFRAMEHISTORY_H
+#define POINTGREYFRAMEHISTORY_H
+
+#include <vector>
+#include "lima/SizeUtils.h"
+#include "lima/Debug.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class FrameHistory
+ * \brief ring of the last frame copies, with their acquisition info
+ *
+ * Frames are copied row by row from the source stride into packed
+ * slots allocated at prepare, the oldest one is overwritten once the
+ * ring is full. One spare slot lets append() add a last frame to a
+ * full ring without losing the oldest.
+ *******************************************************************/
+class FrameHistory
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "FrameHistory", "PointGrey");
+
+public:
+    struct Info {
+        double timestamp;
+        double camera_timestamp;
+        int frame_counter;
+        int gpio_state;
+        int seq_step;
+        int frame_nb;
+        int nb_saturated_sub_frames;
+        int max_saturated_pixels;
+    };
+
+    FrameHistory();
+    ~FrameHistory();
+
+    void setCapacity(int nb_frames);
+    int getCapacity() const { return m_capacity; }
+
+    // allocate the slots, drops the frames
+    void prepare(const FrameDim& frame_dim);
+    const FrameDim& getFrameDim() const { return m_frame_dim; }
+    void clear() { m_nb_frames = 0; }
+
+    void push(const void *src, int src_stride, const Info& info);
+    void append(const void *src, int src_stride, const Info& info);
+    int getNbFrames() const { return m_nb_frames; }
+    // packed frame, 0 is the oldest
+    const void *getFrame(int index, Info& info) const;
+
+private:
+    void _copy(int slot, const void *src, int src_stride, const Info& info);
+
+    int m_capacity;
+    FrameDim m_frame_dim;
+    int m_frame_size;
+    std::vector<char> m_data;
+    std::vector<Info> m_infos;
+    int m_nb_slots;
+    int m_first;
+    int m_nb_frames;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYFRAMEHISTORY_H
@@ -0,0 +1,101 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYFRAMESELECTOR_H
+#define POINTGREYFRAMESELECTOR_H
+
+#include "lima/SizeUtils.h"
+#include "lima/Debug.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class FrameSelector
+ * \brief per-frame trigger criterion with pre/post context counts
+ *
+ * The criterion is evaluated over a region of the frame (the whole
+ * frame if empty). A frame is selected when it fires or when it is
+ * one of the post frames following the last trigger; the caller keeps
+ * the pre frames.
+ *******************************************************************/
+class FrameSelector
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "FrameSelector", "PointGrey");
+
+public:
+    enum Criterion {
+        MaxAbove,       // region max >= threshold
+        SumAbove,       // region sum >= threshold
+        SumChange       // |sum - previous sum| >= threshold * max(previous sum, nb pixels)
+    };
+
+    struct Stats {
+        int nb_frames;          // evaluated
+        int nb_triggers;        // criterion fired
+        int nb_selected;        // triggers and post frames
+        int nb_rejected;
+        double last_value;      // last region max or sum
+    };
+
+    FrameSelector();
+    ~FrameSelector();
+
+    void setCriterion(Criterion criterion) { m_criterion = criterion; }
+    Criterion getCriterion() const { return m_criterion; }
+    void setThreshold(double threshold) { m_threshold = threshold; }
+    double getThreshold() const { return m_threshold; }
+    void setRegion(const Roi& region) { m_region = region; }
+    const Roi& getRegion() const { return m_region; }
+    void setNbPreFrames(int nb_frames);
+    int getNbPreFrames() const { return m_nb_pre_frames; }
+    void setNbPostFrames(int nb_frames);
+    int getNbPostFrames() const { return m_nb_post_frames; }
+
+    // Bpp8, Bpp16 or Bpp32 frames, to be called before acquisition
+    void prepare(const Size& size, ImageType type);
+    bool select(const void *src, int src_stride);
+
+    void getStats(Stats& stats);
+
+private:
+    template <class SrcT> void _measure(const void *src, int src_stride,
+                                        double& sum, double& max_value);
+
+    Criterion m_criterion;
+    double m_threshold;
+    Roi m_region;
+    int m_nb_pre_frames;
+    int m_nb_post_frames;
+
+    ImageType m_type;
+    int m_x0, m_y0, m_width, m_height;
+    double m_previous_sum;
+    bool m_has_previous;
+    int m_post_left;
+
+    Stats m_stats;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYFRAMESELECTOR_H
@@ -0,0 +1,147 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYRECORDER_H
+#define POINTGREYRECORDER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "PointGreyAtomic.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class Recorder
+ * \brief streams raw frames to a sequence file with a sidecar index
+ *
+ * Frames are gathered in large page-aligned buffers written by a
+ * dedicated thread, with O_DIRECT when the file system allows it.
+ * The acquisition thread only waits when every buffer is still
+ * queued for the disk.
+ *
+ * The sequence file starts with a SeqHeader, padded to k_Align, and
+ * frames follow each frame_stride bytes. The index file (file name
+ * + ".idx") holds an IdxHeader followed by one IndexRecord per frame.
+ *******************************************************************/
+class Recorder
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Recorder", "PointGrey");
+
+public:
+    static const int k_Align = 4096;
+
+    struct SeqHeader {
+        char magic[8];          // "PGRYSEQ1"
+        int version;
+        int width;
+        int height;
+        int image_type;         // lima::ImageType
+        int frame_size;         // bytes of frame data
+        int frame_stride;       // bytes between frames, multiple of k_Align
+        int header_size;        // offset of the first frame
+        int nb_frames;
+    };
+
+    struct IdxHeader {
+        char magic[8];          // "PGRYIDX1"
+        int version;
+        int record_size;
+    };
+
+    struct IndexRecord {
+        long long offset;       // of the frame in the sequence file
+        double timestamp;       // host time, s since epoch
+        double camera_timestamp;// s
+        int acq_frame_nb;
+        int frame_counter;      // camera frame counter, -1 if unknown
+    };
+
+    struct Stats {
+        int nb_frames;
+        int nb_waits;           // frames which had to wait for the disk
+        double nb_bytes;
+        double write_rate;      // MB/s over the recording
+        bool direct_io;
+    };
+
+    Recorder();
+    ~Recorder();
+
+    void setFileName(const std::string& file_name);
+    const std::string& getFileName() const { return m_file_name; }
+    void setNbBuffers(int nb_buffers);
+    int getNbBuffers() const { return m_nb_buffers; }
+    void setBufferSize(int nb_frames);
+    int getBufferSize() const { return m_buffer_size; }
+
+    void open(const FrameDim& frame_dim);
+    void write(const void *frame, int stride, const IndexRecord& record);
+    void close();
+    bool isOpen() const { return m_fd >= 0; }
+
+    void getStats(Stats& stats);
+
+private:
+    class _Writer;
+    friend class _Writer;
+
+    struct _Buffer {
+        char *data;
+        int nb_frames;
+        std::vector<IndexRecord> records;
+        bool busy;
+    };
+
+    void _submit();
+    void _writeHeader();
+    void _freeBuffers();
+
+    std::string m_file_name;
+    int m_nb_buffers;
+    int m_buffer_size;
+
+    FrameDim m_frame_dim;
+    SeqHeader m_header;
+    int m_fd;
+    FILE *m_idx_file;
+    bool m_direct_io;
+
+    std::vector<_Buffer> m_buffers;
+    std::vector<int> m_queue;
+    int m_fill;
+    _Writer *m_writer;
+    Cond m_cond;
+    bool m_quit;
+    bool m_failed;
+
+    Stats m_stats;
+    Atomic<int> m_nb_frames;    // counted by write() without the lock
+    double m_start_time;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYRECORDER_H
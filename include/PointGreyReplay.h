@@ -0,0 +1,95 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYREPLAY_H
+#define POINTGREYREPLAY_H
+
+#include <string>
+#include <vector>
+#include "lima/ThreadUtils.h"
+#include "PointGreyAtomic.h"
+#include "PointGreyRecorder.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class Replay
+ * \brief memory-mapped frame source reading a Recorder sequence
+ *
+ * Frames are served straight from the mapping, paced like the
+ * recording, as fast as possible or at a fixed rate.
+ *******************************************************************/
+class Replay
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Replay", "PointGrey");
+
+public:
+    enum Pacing {
+        Recorded, AsFastAsPossible, FixedRate
+    };
+
+    Replay();
+    ~Replay();
+
+    void open(const std::string& file_name);
+    void close();
+    bool isOpen() const { return m_data != NULL; }
+    const std::string& getFileName() const { return m_file_name; }
+    const Recorder::SeqHeader& getHeader() const { return m_header; }
+    FrameDim getFrameDim() const;
+    int getNbFrames() const { return m_records.size(); }
+
+    void setPacing(Pacing pacing) { m_pacing = pacing; }
+    Pacing getPacing() const { return m_pacing; }
+    void setFrameRate(double frame_rate);
+    double getFrameRate() const { return m_frame_rate; }
+    void setLoop(bool loop) { m_loop = loop; }
+    bool getLoop() const { return m_loop; }
+
+    // rewind and restart the pacing clock
+    void start();
+    void abort();
+    // wait for the next frame, false once the sequence is over or aborted
+    bool next(const void *& frame, Recorder::IndexRecord& record);
+
+private:
+    std::string m_file_name;
+    Recorder::SeqHeader m_header;
+    std::vector<Recorder::IndexRecord> m_records;
+    char *m_data;
+    size_t m_size;
+
+    Pacing m_pacing;
+    double m_frame_rate;
+    bool m_loop;
+
+    int m_next;
+    int m_nb_served;
+    double m_start_time;
+    Cond m_cond;
+    Atomic<bool> m_aborted;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYREPLAY_H
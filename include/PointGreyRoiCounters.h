@@ -0,0 +1,120 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYROICOUNTERS_H
+#define POINTGREYROICOUNTERS_H
+
+#include <string>
+#include <vector>
+#include "lima/SizeUtils.h"
+#include "lima/Debug.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class RoiCounters
+ * \brief sum, mean, min and max over rectangular regions of every frame
+ *
+ * The frame is read once, row by row. Each row crossed by a region
+ * gets one prefix sum over the span of its regions, every region then
+ * takes its sum from two prefix values and scans its segment for the
+ * min and max while it is still in cache. One record per frame goes
+ * to a ring of seqlock slots, as for the beam analysis:
+ *   acq_frame_nb, timestamp, then sum, mean, min, max of each region.
+ *******************************************************************/
+class RoiCounters
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "RoiCounters", "PointGrey");
+
+public:
+    struct Stats {
+        int nb_frames;
+        double mean_time;       // s per frame
+        double max_time;        // s
+    };
+
+    static const int k_NbHeaderFields = 2;
+    static const int k_NbRoiFields = 4;
+
+    RoiCounters();
+    ~RoiCounters();
+
+    void clear();
+    // returns the region index
+    int add(const Roi& roi);
+    int getNbRois() const { return m_rois.size(); }
+    const Roi& getRoi(int index) const;
+    void setSeriesSize(int nb_records);
+    int getSeriesSize() const { return m_series_size; }
+
+    // Bpp8, Bpp16 or Bpp32 frames, to be called before acquisition
+    void prepare(const Size& size, ImageType type);
+    void process(const void *src, int src_stride, int acq_frame_nb, double timestamp);
+
+    // float64 per record, set at prepare
+    int getRecordSize() const { return m_record_size; }
+
+    // lock-free readers
+    long long getWriteCount() const;
+    bool getRecord(long long index, double *record) const;
+    // up to max_nb records from index first (or the oldest still in the ring)
+    void getSeries(long long first, int max_nb, std::string& data) const;
+
+    void getStats(Stats& stats);
+
+private:
+    struct _Rect {
+        int x0, y0, x1, y1;     // x1 and y1 excluded
+    };
+
+    template <class SrcT> void _process(const void *src, int src_stride);
+
+    std::vector<Roi> m_rois;
+    int m_series_size;
+
+    Size m_size;
+    ImageType m_type;
+    std::vector<_Rect> m_rects;
+    // regions crossing row y: m_row_rois[m_row_begin[y]..m_row_begin[y + 1]]
+    std::vector<int> m_row_begin;
+    std::vector<int> m_row_rois;
+    // span of the regions crossing each row
+    std::vector<int> m_row_x0;
+    std::vector<int> m_row_x1;
+    std::vector<long long> m_prefix;
+
+    std::vector<long long> m_sums;
+    std::vector<unsigned int> m_mins;
+    std::vector<unsigned int> m_maxs;
+
+    int m_record_size;
+    std::vector<long long> m_seqs;
+    std::vector<double> m_records;
+    long long m_write_count;
+
+    Stats m_stats;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYROICOUNTERS_H
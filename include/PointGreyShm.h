@@ -0,0 +1,165 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYSHM_H
+#define POINTGREYSHM_H
+
+#include <string>
+#include "lima/SizeUtils.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class ShmPublisher
+ * \brief frame ring in POSIX shared memory for other processes
+ *
+ * The segment starts with a Header, padded to k_Align, followed by
+ * nb_slots slots of slot_size bytes. Each slot holds a SlotHeader,
+ * padded to k_SlotHeaderSize, then the frame data. Frame n goes to
+ * slot n % nb_slots.
+ *
+ * Slots are seqlocks: seq is odd while the slot is written and is
+ * 2 * (n + 1) once frame n is complete. The publisher never waits
+ * for readers; a reader detects an overwritten frame from seq. When
+ * the layout changes the segment is replaced and the old one is
+ * flagged closed.
+ *******************************************************************/
+class ShmPublisher
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "ShmPublisher", "PointGrey");
+
+public:
+    static const int k_Align = 4096;
+    static const int k_SlotHeaderSize = 128;
+
+    struct Header {
+        char magic[8];          // "PGRYSHM1"
+        int version;
+        int header_size;        // offset of the first slot
+        int slot_size;
+        int nb_slots;
+        int width;
+        int height;
+        int image_type;         // lima::ImageType
+        int depth;              // bytes per pixel
+        int frame_size;         // bytes of frame data
+        int closed;             // the segment was replaced, attach again
+        int reserved[2];
+        long long write_count;  // frames published
+    };
+
+    struct SlotHeader {
+        long long seq;
+        long long frame_index;  // publisher frame count
+        int acq_frame_nb;
+        int frame_counter;
+        int gpio_state;
+        int seq_step;
+        double timestamp;
+        double camera_timestamp;
+        double synced_timestamp;
+        double exp_time;
+        double gain;
+    };
+
+    struct Stats {
+        int nb_frames;
+        double nb_bytes;
+        double mean_time;       // s per frame
+        double max_time;        // s
+    };
+
+    ShmPublisher();
+    ~ShmPublisher();
+
+    void setName(const std::string& name);
+    const std::string& getName() const { return m_name; }
+    void setNbSlots(int nb_slots);
+    int getNbSlots() const { return m_nb_slots; }
+
+    // create the segment, kept when the layout did not change
+    void prepare(const FrameDim& frame_dim);
+    // seq and frame_index of info are set by the publisher
+    void publish(const void *frame, const SlotHeader& info);
+    void close();
+    bool isOpen() const { return m_header != NULL; }
+
+    void getStats(Stats& stats);
+
+private:
+    void _unmap();
+
+    std::string m_name;
+    int m_nb_slots;
+
+    std::string m_open_name;
+    Header *m_header;
+    char *m_data;
+    size_t m_size;
+
+    Stats m_stats;
+};
+
+/*******************************************************************
+ * \class ShmReader
+ * \brief zero-copy access to a ShmPublisher ring
+ *
+ * getFrame() points into the segment; once the reader is done with
+ * the data, isValid() tells whether the frame was overwritten in
+ * between. copyFrame() returns a consistent copy.
+ *******************************************************************/
+class ShmReader
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "ShmReader", "PointGrey");
+
+public:
+    ShmReader();
+    ~ShmReader();
+
+    void attach(const std::string& name);
+    void detach();
+    bool isAttached() const { return m_header != NULL; }
+    // the publisher replaced the segment, attach again
+    bool isClosed() const;
+
+    const ShmPublisher::Header& getHeader() const { return *m_header; }
+    FrameDim getFrameDim() const;
+    long long getWriteCount() const;
+
+    // false if the frame is not published yet or already overwritten
+    bool getFrame(long long frame_index, const void *& data,
+                  ShmPublisher::SlotHeader& info) const;
+    bool isValid(long long frame_index) const;
+    bool copyFrame(long long frame_index, void *buffer,
+                   ShmPublisher::SlotHeader& info) const;
+
+private:
+    const ShmPublisher::SlotHeader *_getSlot(long long frame_index) const;
+
+    const ShmPublisher::Header *m_header;
+    size_t m_size;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYSHM_H
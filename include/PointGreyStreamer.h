@@ -0,0 +1,145 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYSTREAMER_H
+#define POINTGREYSTREAMER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "PointGreyAtomic.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class Streamer
+ * \brief TCP server sending frames and metadata to remote viewers
+ *
+ * Each frame is sent as a Header followed by payload_size bytes of
+ * frame data, LZ4 block compressed when compressed is set. Every
+ * client has its own sender thread and a bounded queue: when a slow
+ * client's queue is full its oldest frame is dropped, publish() only
+ * copies the frame and never waits for the network.
+ *******************************************************************/
+class Streamer
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Streamer", "PointGrey");
+
+public:
+    struct Header {
+        char magic[4];          // "PGST"
+        int version;
+        int header_size;
+        int width;
+        int height;
+        int image_type;         // lima::ImageType
+        int depth;              // bytes per pixel
+        int compressed;
+        int payload_size;
+        int raw_size;
+        int acq_frame_nb;
+        int frame_counter;
+        int gpio_state;
+        int seq_step;
+        int nb_dropped;         // frames dropped for this client so far
+        int reserved;
+        double timestamp;
+        double camera_timestamp;
+        double synced_timestamp;
+        double exp_time;
+        double gain;
+    };
+
+    struct ClientStats {
+        std::string address;
+        int queue_depth;        // frames waiting to be sent
+        int nb_sent;
+        int nb_dropped;
+        double nb_bytes;
+        double bandwidth;       // MB/s since the connection
+    };
+
+    Streamer();
+    ~Streamer();
+
+    void setPort(int port);
+    int getPort() const { return m_port; }
+    // port in use, the configured one or a free one if it is 0
+    int getBoundPort() const { return m_bound_port; }
+    void setDecimation(int decimation);
+    int getDecimation() const { return m_decimation; }
+    void setCompression(bool compression) { m_compression = compression; }
+    bool getCompression() const { return m_compression; }
+    void setQueueDepth(int nb_frames);
+    int getQueueDepth() const { return m_queue_depth; }
+    void setMaxClients(int nb_clients);
+    int getMaxClients() const { return m_max_clients; }
+
+    void start();
+    void stop();
+    bool isRunning() const { return m_listen_fd >= 0; }
+
+    // header layout and size fields are set by the streamer
+    void publish(const void *frame, const FrameDim& frame_dim, const Header& info);
+
+    int getNbClients();
+    void getClientStats(int client, ClientStats& stats);
+
+private:
+    class _Listener;
+    class _Client;
+    struct _Message;
+    friend class _Listener;
+    friend class _Client;
+
+    _Message *_getMessage();
+    void _releaseMessage(_Message *msg);
+    void _addClient(int fd, const std::string& address);
+    void _reapClients(bool all);
+
+    int m_port;
+    int m_bound_port;
+    int m_decimation;
+    bool m_compression;
+    int m_queue_depth;
+    int m_max_clients;
+
+    int m_listen_fd;
+    int m_wake_fds[2];
+    _Listener *m_listener;
+
+    Mutex m_lock;
+    std::vector<_Client *> m_clients;
+    Atomic<int> m_nb_clients;
+    int m_frame_count;
+
+    // recycled messages, so that publish() does not allocate frames
+    Mutex m_pool_lock;
+    std::vector<_Message *> m_pool;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYSTREAMER_H
@@ -0,0 +1,144 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYTRACER_H
+#define POINTGREYTRACER_H
+
+#include <pthread.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "lima/ThreadUtils.h"
+#include "PointGreyAtomic.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class Tracer
+ * \brief binary event trace of the frame pipeline and control calls
+ *
+ * Each thread writes its events into its own ring, allocated at its
+ * first event, without locking: a trace point costs two clock reads
+ * when active and a relaxed load when not. The rings are kept across
+ * thread exits for the next new thread. dump() writes the events in
+ * the Chrome trace JSON format (chrome://tracing, Perfetto).
+ *
+ * Trace points are compiled out with -DPOINTGREY_NO_TRACE.
+ *******************************************************************/
+class Tracer
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Tracer", "PointGrey");
+
+public:
+    struct Stats {
+        int nb_buffers;             // one per tracing thread, reused after its exit
+        long long nb_events;        // written since the last clear
+        long long nb_lost;          // overwritten before being dumped
+    };
+
+    // records the scope duration, name must be a string literal
+    class Scope
+    {
+    public:
+        Scope(Tracer& tracer, const char *name, int arg)
+            : m_tracer(tracer), m_name(name), m_arg(arg),
+              m_start(tracer.isActive() ? now() : 0) {}
+        ~Scope()
+        { if (m_start) m_tracer.add(m_name, m_arg, m_start, now()); }
+    private:
+        Tracer& m_tracer;
+        const char *m_name;
+        int m_arg;
+        long long m_start;
+    };
+
+    static const int k_DefaultBufferSize = 65536;
+
+    Tracer();
+    ~Tracer();
+
+    void setActive(bool active);
+    bool isActive() const { return m_active.load(__ATOMIC_RELAXED); }
+    // events per thread, for the rings allocated afterwards
+    void setBufferSize(int nb_events);
+    int getBufferSize() const { return m_buffer_size; }
+
+    void clear();
+    void add(const char *name, int arg, long long start, long long end);
+    void dump(const std::string& file_name);
+    void getStats(Stats& stats);
+
+    // CLOCK_MONOTONIC, ns
+    static long long now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+private:
+    struct _Event {
+        long long start;            // ns
+        long long end;
+        const char *name;
+        int arg;
+        int tid;
+    };
+
+    struct _Buffer {
+        std::vector<_Event> events;
+        Atomic<long long> nb_written;
+        Atomic<long long> first;    // events before were cleared
+        Atomic<bool> released;      // its thread exited
+        int tid;
+    };
+
+    Tracer(const Tracer&);
+    Tracer& operator=(const Tracer&);
+
+    _Buffer *_getBuffer();
+    static void _releaseBuffer(void *buffer);
+
+    Mutex m_lock;
+    Atomic<bool> m_active;
+    int m_buffer_size;
+    pthread_key_t m_key;
+    std::vector<_Buffer *> m_buffers;
+    std::map<int, std::string> m_thread_names;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#define POINTGREY_TRACE_CAT2(a, b) a##b
+#define POINTGREY_TRACE_CAT(a, b) POINTGREY_TRACE_CAT2(a, b)
+
+// traces the enclosing scope
+#ifdef POINTGREY_NO_TRACE
+#define POINTGREY_TRACE(tracer, name, arg) do {} while (0)
+#else
+#define POINTGREY_TRACE(tracer, name, arg) \
+    lima::PointGrey::Tracer::Scope POINTGREY_TRACE_CAT(_trace_scope_, __LINE__)((tracer), (name), (arg))
+#endif
+
+#endif // POINTGREYTRACER_H
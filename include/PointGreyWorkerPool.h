@@ -0,0 +1,77 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef POINTGREYWORKERPOOL_H
+#define POINTGREYWORKERPOOL_H
+
+#include <vector>
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+namespace PointGrey
+{
+/*******************************************************************
+ * \class WorkerPool
+ * \brief fixed set of threads splitting a per-frame job in parts
+ *
+ * The calling thread runs part 0 itself, so a pool of one thread
+ * runs the job inline without any hand-over.
+ *******************************************************************/
+class WorkerPool
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "WorkerPool", "PointGrey");
+
+public:
+    class Job
+    {
+    public:
+        virtual ~Job() {};
+        virtual void run(int part, int nb_parts) = 0;
+    };
+
+    WorkerPool();
+    ~WorkerPool();
+
+    void setNbThreads(int nb_threads);
+    int getNbThreads() const { return m_workers.size() + 1; }
+
+    // run all parts of the job and return once they are finished
+    void run(Job& job);
+
+private:
+    class _Worker;
+    friend class _Worker;
+
+    void _stopWorkers();
+
+    std::vector<_Worker*> m_workers;
+    Cond m_cond;
+    Job *m_job;
+    int m_generation;
+    int m_nb_pending;
+    bool m_quit;
+};
+} // namespace PointGrey
+} // namespace lima
+
+#endif // POINTGREYWORKERPOOL_H
@@ -0,0 +1,256 @@
+############################################################################
+# This file is part of LImA, a Library for Image Acquisition
+#
+# Copyright (C) : 2009-2011
+# European Synchrotron Radiation Facility
+# BP 220, Grenoble 38043
+# FRANCE
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, see <http://www.gnu.org/licenses/>.
+############################################################################
+"""Lossless round-trip test and throughput benchmark of the compression.
+
+Synthetic frames are written as a sequence file and replayed through a
+replay camera with the compression active. Every compressed frame must
+decompress to the original, with decompressFrame() and with the reference
+LZ4 codec of the python lz4 module, which also encodes frames that
+decompressFrame() must restore. The frame size is not a multiple of the
+chunk size, so the last chunk of each frame is partial.
+The acquisition rate is then measured with and without the compression,
+the latter being the plain copy into the Lima buffers:
+
+  python PointGreyCompressionTest.py [--frames 100] [--threads 4]
+"""
+import argparse
+import os
+import struct
+import sys
+import tempfile
+import time
+
+import numpy
+
+from Lima import Core
+from Lima import PointGrey
+
+# reference codec, required by the round-trip test
+try:
+    import lz4.block as lz4_block
+except ImportError:
+    lz4_block = None
+
+# PointGreyRecorder.h
+_SEQ_HEADER = struct.Struct('<8s8i')
+_ALIGN = 4096
+_IMAGE_TYPES = {numpy.uint8: int(Core.Bpp8), numpy.uint16: int(Core.Bpp16)}
+# PointGreyCompressor.cpp
+_HEADER_WORDS = 4
+_STORED_FLAG = 0x80000000
+
+WIDTH = 1001
+HEIGHT = 333
+CHUNK_SIZE = 64 * 1024
+
+
+def make_frames(pattern, dtype, nb_frames, seed=0):
+    """Synthetic frames of a pattern."""
+    rng = numpy.random.RandomState(seed)
+    shape = (nb_frames, HEIGHT, WIDTH)
+    full_scale = numpy.iinfo(dtype).max
+    if pattern == 'constant':
+        return numpy.full(shape, full_scale // 3, dtype)
+    if pattern == 'random':
+        # dark level and noise of a real sensor
+        level = min(100, full_scale // 4)
+        noise = rng.poisson(8, shape)
+        return numpy.clip(level + noise, 0, full_scale).astype(dtype)
+    if pattern == 'incompressible':
+        return rng.randint(0, full_scale + 1, shape).astype(dtype)
+    raise ValueError('unknown pattern ' + pattern)
+
+
+def align(size):
+    return (size + _ALIGN - 1) // _ALIGN * _ALIGN
+
+
+def write_sequence(file_name, frames):
+    """Sequence file in the recorder format, without index."""
+    nb_frames, height, width = frames.shape
+    frame_size = frames[0].nbytes
+    frame_stride = align(frame_size)
+    header_size = align(_SEQ_HEADER.size)
+    header = _SEQ_HEADER.pack(b'PGRYSEQ1', 1, width, height,
+                              _IMAGE_TYPES[frames.dtype.type], frame_size,
+                              frame_stride, header_size, nb_frames)
+    with open(file_name, 'wb') as f:
+        f.write(header.ljust(header_size, b'\0'))
+        for frame in frames:
+            f.write(frame.tobytes().ljust(frame_stride, b'\0'))
+
+
+def shuffle(chunk, element_size):
+    """Byte planes of the elements, as the compressor orders them."""
+    chunk = numpy.frombuffer(chunk, numpy.uint8)
+    return chunk.reshape(-1, element_size).T.tobytes()
+
+
+def ref_compress(raw, element_size, chunk_size):
+    """Compressed frame layout encoded with the reference codec."""
+    nb_chunks = (len(raw) + chunk_size - 1) // chunk_size
+    sizes = []
+    blocks = []
+    for c in range(nb_chunks):
+        chunk = raw[c * chunk_size:(c + 1) * chunk_size]
+        if element_size > 1:
+            chunk = shuffle(chunk, element_size)
+        block = lz4_block.compress(chunk, store_size=False)
+        sizes.append(len(block))
+        blocks.append(block)
+    header = struct.pack('<%dI' % (_HEADER_WORDS + nb_chunks), len(raw),
+                         element_size, nb_chunks, chunk_size, *sizes)
+    return header + b''.join(blocks)
+
+
+def py_decompress(data):
+    """Decoder of the compressed frame layout with the reference codec."""
+    raw_size, element_size, nb_chunks, chunk_size = \
+        struct.unpack_from('<4I', data)
+    sizes = struct.unpack_from('<%dI' % nb_chunks, data, 4 * _HEADER_WORDS)
+    pos = 4 * (_HEADER_WORDS + nb_chunks)
+    raw = bytearray()
+    for c, size in enumerate(sizes):
+        chunk_raw_size = min(chunk_size, raw_size - c * chunk_size)
+        stored = size & _STORED_FLAG
+        size &= ~_STORED_FLAG
+        block = bytes(data[pos:pos + size])
+        pos += size
+        if stored:
+            raw += block
+            continue
+        chunk = lz4_block.decompress(block, uncompressed_size=chunk_raw_size)
+        if element_size > 1:
+            chunk = numpy.frombuffer(bytes(chunk), numpy.uint8)
+            chunk = chunk.reshape(element_size, -1).T.tobytes()
+        raw += chunk
+    return bytes(raw)
+
+
+class ReplayAcq(object):
+    """Acquisitions of a replayed sequence through the hardware interface."""
+
+    def __init__(self, file_name, nb_buffers=16, timeout=60.):
+        self.cam = PointGrey.Camera(file_name)
+        self.cam.setReplayPacing(PointGrey.Camera.ReplayAsFastAsPossible)
+        self.cam.setReplayLoop(True)
+        self.interface = PointGrey.Interface(self.cam)
+        buffer = self.interface.getHwCtrlObj(Core.HwCap.Buffer)
+        det_info = self.interface.getHwCtrlObj(Core.HwCap.DetInfo)
+        self.sync = self.interface.getHwCtrlObj(Core.HwCap.Sync)
+        buffer.setFrameDim(Core.FrameDim(det_info.getMaxImageSize(),
+                                         det_info.getCurrImageType()))
+        buffer.setNbBuffers(nb_buffers)
+        self.timeout = timeout
+
+    def run(self, nb_frames):
+        """Acquisition time in s."""
+        self.sync.setNbHwFrames(nb_frames)
+        self.interface.prepareAcq()
+        start = time.perf_counter()
+        self.interface.startAcq()
+        ready = self.cam.waitForFrame(nb_frames - 1, self.timeout)
+        elapsed = time.perf_counter() - start
+        self.interface.stopAcq()
+        if not ready:
+            raise RuntimeError('acquisition timed out: %s' % self.cam.getStatus())
+        return elapsed
+
+
+def round_trip(dtype, pattern, nb_frames, nb_threads, tmp_dir):
+    """Number of frames which did not decompress to the original."""
+    frames = make_frames(pattern, dtype, nb_frames)
+    file_name = os.path.join(tmp_dir, 'rt_%s_%s.pgr' % (dtype.__name__, pattern))
+    write_sequence(file_name, frames)
+    acq = ReplayAcq(file_name)
+    acq.cam.setCompressionChunkSize(CHUNK_SIZE)
+    acq.cam.setCompressionNbThreads(nb_threads)
+    acq.cam.setCompressionRingSize(nb_frames)
+    acq.cam.setCompressionActive(True)
+    acq.run(nb_frames)
+
+    nb_errors = 0
+    compressed_size = 0
+    for i, frame in enumerate(frames):
+        data = acq.cam.getCompressedFrame(i)
+        compressed_size += len(data)
+        raw = frame.tobytes()
+        ref_data = ref_compress(raw, frame.itemsize, CHUNK_SIZE)
+        if (PointGrey.Camera.decompressFrame(data) != raw or py_decompress(data) != raw or
+                PointGrey.Camera.decompressFrame(ref_data) != raw):
+            nb_errors += 1
+    print('round-trip %-6s %-14s %d frames, ratio %.2f: %s' %
+          (dtype.__name__, pattern, nb_frames, frames.nbytes / float(compressed_size),
+           'ok' if not nb_errors else '%d errors' % nb_errors))
+    os.remove(file_name)
+    return nb_errors
+
+
+def throughput(dtype, nb_frames, nb_threads, tmp_dir):
+    """Frame rate with the plain copy and with the compression."""
+    frames = make_frames('random', dtype, 16)
+    file_name = os.path.join(tmp_dir, 'tp_%s.pgr' % dtype.__name__)
+    write_sequence(file_name, frames)
+    acq = ReplayAcq(file_name)
+    mbytes = frames[0].nbytes * nb_frames / 1e6
+
+    acq.cam.setCompressionActive(False)
+    copy_time = acq.run(nb_frames)
+    acq.cam.setCompressionChunkSize(CHUNK_SIZE)
+    acq.cam.setCompressionNbThreads(nb_threads)
+    acq.cam.setCompressionActive(True)
+    comp_time = acq.run(nb_frames)
+    stats = acq.cam.getCompressionStats()
+    print('throughput %-6s copy %.0f frames/s %.0f MB/s, compression %.0f frames/s '
+          '%.0f MB/s (%d threads, ratio %.2f, mean %.2f ms, max %.2f ms)' %
+          (dtype.__name__, nb_frames / copy_time, mbytes / copy_time,
+           nb_frames / comp_time, mbytes / comp_time, nb_threads,
+           stats.ratio, stats.mean_time * 1e3, stats.max_time * 1e3))
+    os.remove(file_name)
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--frames', type=int, default=20,
+                        help='frames per round-trip sequence')
+    parser.add_argument('--bench-frames', type=int, default=1000,
+                        help='frames per throughput acquisition')
+    parser.add_argument('--threads', type=int, default=4)
+    args = parser.parse_args(argv[1:])
+    if lz4_block is None:
+        parser.error('the reference lz4 python module is required (pip install lz4)')
+
+    tmp_dir = tempfile.mkdtemp(prefix='pointgrey_compression_')
+    nb_errors = 0
+    try:
+        for dtype in (numpy.uint8, numpy.uint16):
+            for pattern in ('random', 'constant', 'incompressible'):
+                nb_errors += round_trip(dtype, pattern, args.frames, args.threads, tmp_dir)
+        for dtype in (numpy.uint8, numpy.uint16):
+            throughput(dtype, args.bench_frames, args.threads, tmp_dir)
+    finally:
+        os.rmdir(tmp_dir)
+    return 1 if nb_errors else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
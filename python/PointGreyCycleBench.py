@@ -0,0 +1,179 @@
+############################################################################
+# This file is part of LImA, a Library for Image Acquisition
+#
+# Copyright (C) : 2009-2011
+# European Synchrotron Radiation Facility
+# BP 220, Grenoble 38043
+# FRANCE
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, see <http://www.gnu.org/licenses/>.
+############################################################################
+"""Acquisition control latency benchmark.
+
+Runs many short acquisitions through the hardware interface, changing
+parameters between them, and reports the latency distribution of every
+control call and the dead time of each cycle as JSON. A replay camera
+stands in for the device when none is connected:
+
+  python PointGreyCycleBench.py --replay seq.pgr --cycles 2000 --frames 1
+  python PointGreyCycleBench.py --serial 12345678 --changes exp,type -o out.json
+"""
+import argparse
+import json
+import sys
+import time
+
+from Lima import Core
+from Lima import PointGrey
+
+# parameters changed between cycles, alternating between two values; the
+# camera has no other internal trigger mode than IntTrig, so 'trig' only
+# rewrites the same mode and measures the cost of an unchanged set
+CHANGES = ('exp', 'trig', 'type', 'frames')
+
+
+def percentile(samples, p):
+    """Nearest-rank percentile of sorted samples."""
+    if not samples:
+        return 0.
+    index = int(round(p / 100. * (len(samples) - 1)))
+    return samples[index]
+
+
+def summarize(samples):
+    """Latency distribution in ms."""
+    samples = sorted(s * 1e3 for s in samples)
+    n = len(samples)
+    return {'n': n,
+            'min': samples[0] if n else 0.,
+            'mean': sum(samples) / n if n else 0.,
+            'p50': percentile(samples, 50),
+            'p90': percentile(samples, 90),
+            'p99': percentile(samples, 99),
+            'max': samples[-1] if n else 0.}
+
+
+class CycleBench(object):
+    """Prepare/start/stop cycles on a hardware interface."""
+
+    def __init__(self, cam, nb_buffers=16, timeout=10.):
+        self.cam = cam
+        self.interface = PointGrey.Interface(cam)
+        self.buffer = self.interface.getHwCtrlObj(Core.HwCap.Buffer)
+        self.sync = self.interface.getHwCtrlObj(Core.HwCap.Sync)
+        self.det_info = self.interface.getHwCtrlObj(Core.HwCap.DetInfo)
+        self.nb_buffers = nb_buffers
+        self.timeout = timeout
+        self.samples = {}
+
+    def _timed(self, name, func, *args):
+        start = time.perf_counter()
+        result = func(*args)
+        self.samples.setdefault(name, []).append(time.perf_counter() - start)
+        return result
+
+    def _set_frame_dim(self):
+        frame_dim = Core.FrameDim(self.det_info.getMaxImageSize(),
+                                  self.det_info.getCurrImageType())
+        self.buffer.setFrameDim(frame_dim)
+        self.buffer.setNbBuffers(self.nb_buffers)
+
+    def run(self, nb_cycles, nb_frames, exp_times, changes):
+        image_types = (Core.Bpp8, Core.Bpp16)
+        self.sync.setTrigMode(Core.IntTrig)
+        self.sync.setExpTime(exp_times[0])
+        self._set_frame_dim()
+        self.samples = {}
+        nb_failed = 0
+        for cycle in range(nb_cycles):
+            alt = cycle % 2
+            cycle_start = time.perf_counter()
+            if 'exp' in changes:
+                self._timed('setExpTime', self.sync.setExpTime, exp_times[alt])
+            if 'trig' in changes:
+                self._timed('setTrigMode', self.sync.setTrigMode, Core.IntTrig)
+            if 'type' in changes:
+                self._timed('setCurrImageType', self.det_info.setCurrImageType,
+                            image_types[alt])
+                self._timed('setFrameDim', self._set_frame_dim)
+            nb = nb_frames + alt if 'frames' in changes else nb_frames
+            self._timed('setNbHwFrames', self.sync.setNbHwFrames, nb)
+            self._timed('prepareAcq', self.interface.prepareAcq)
+            self._timed('startAcq', self.interface.startAcq)
+            acq_start = time.perf_counter()
+            ready = self.cam.waitForFrame(nb - 1, self.timeout)
+            acq_time = time.perf_counter() - acq_start
+            if not ready:
+                nb_failed += 1
+            self._timed('stopAcq', self.interface.stopAcq)
+            cycle_time = time.perf_counter() - cycle_start
+            self.samples.setdefault('acquisition', []).append(acq_time)
+            self.samples.setdefault('cycle', []).append(cycle_time)
+            self.samples.setdefault('dead_time', []).append(cycle_time - acq_time)
+        return {'nb_cycles': nb_cycles,
+                'nb_frames': nb_frames,
+                'changes': sorted(changes),
+                'nb_failed': nb_failed,
+                'total_dead_time': sum(self.samples['dead_time']),
+                'latency_ms': dict((name, summarize(samples))
+                                   for name, samples in self.samples.items())}
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--serial', type=int, help='camera serial number')
+    source.add_argument('--replay', help='sequence file to replay')
+    parser.add_argument('--cycles', type=int, default=1000)
+    parser.add_argument('--frames', type=int, default=1,
+                        help='frames per acquisition')
+    parser.add_argument('--exp-time', default='0.001,0.002',
+                        help='two exposure times in s, alternated')
+    parser.add_argument('--changes', default='exp,frames',
+                        help='parameters changed between cycles, among ' +
+                        ','.join(CHANGES) + ' (trig rewrites IntTrig)')
+    parser.add_argument('--buffers', type=int, default=16)
+    parser.add_argument('--timeout', type=float, default=10.,
+                        help='acquisition timeout in s')
+    parser.add_argument('-o', '--output', help='JSON file, stdout by default')
+    args = parser.parse_args(argv[1:])
+
+    changes = set(c for c in args.changes.split(',') if c)
+    unknown = changes - set(CHANGES)
+    if unknown:
+        parser.error('unknown changes: ' + ','.join(sorted(unknown)))
+    exp_times = [float(t) for t in args.exp_time.split(',')]
+    if len(exp_times) == 1:
+        exp_times *= 2
+
+    if args.replay:
+        cam = PointGrey.Camera(args.replay)
+        cam.setReplayPacing(PointGrey.Camera.ReplayAsFastAsPossible)
+        cam.setReplayLoop(True)
+    else:
+        cam = PointGrey.Camera(args.serial)
+    bench = CycleBench(cam, args.buffers, args.timeout)
+    result = bench.run(args.cycles, args.frames, exp_times, changes)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(result, f, indent=2, sort_keys=True)
+    else:
+        json.dump(result, sys.stdout, indent=2, sort_keys=True)
+        sys.stdout.write('\n')
+    return 1 if result['nb_failed'] else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
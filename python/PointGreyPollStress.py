@@ -0,0 +1,151 @@
+############################################################################
+# This file is part of LImA, a Library for Image Acquisition
+#
+# Copyright (C) : 2009-2011
+# European Synchrotron Radiation Facility
+# BP 220, Grenoble 38043
+# FRANCE
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, see <http://www.gnu.org/licenses/>.
+############################################################################
+"""Stress test of the status and frame counter pollers.
+
+A replayed sequence is acquired as fast as possible while N threads call
+getStatus() and getNbHwAcquiredFrames() in a tight loop, the GIL being
+released by both calls. The frame rate is compared with the one of the
+same acquisition without pollers, and every poller checks that the frame
+counter never goes backwards and ends on the number of frames acquired:
+
+  python PointGreyPollStress.py [--replay seq.pgr] [--pollers 8] [--frames 5000]
+"""
+import argparse
+import os
+import sys
+import tempfile
+import threading
+import time
+
+import numpy
+
+from Lima import Core
+from Lima import PointGrey
+
+try:
+    from Lima.PointGrey import PointGreyCompressionTest
+except ImportError:
+    import PointGreyCompressionTest
+
+STATUSES = (PointGrey.Camera.Ready, PointGrey.Camera.Exposure,
+            PointGrey.Camera.Readout, PointGrey.Camera.Latency,
+            PointGrey.Camera.Fault)
+
+
+class Poller(threading.Thread):
+    """Polls the camera status and frame counter until stopped."""
+
+    def __init__(self, cam, stop):
+        threading.Thread.__init__(self)
+        self.daemon = True
+        self.cam = cam
+        self.stop = stop
+        self.nb_polls = 0
+        self.nb_errors = 0
+        self.last_nb_frames = 0
+
+    def run(self):
+        last = 0
+        while not self.stop.is_set():
+            status = self.cam.getStatus()
+            nb_frames = self.cam.getNbHwAcquiredFrames()
+            if status not in STATUSES or nb_frames < last:
+                self.nb_errors += 1
+            last = nb_frames
+            self.nb_polls += 1
+        self.last_nb_frames = last
+
+
+class PollAcq(PointGreyCompressionTest.ReplayAcq):
+    """Replayed acquisitions, optionally polled by concurrent threads."""
+
+    def run_polled(self, nb_frames, nb_pollers):
+        """Acquisition time in s and the pollers."""
+        self.sync.setNbHwFrames(nb_frames)
+        self.interface.prepareAcq()
+        stop = threading.Event()
+        pollers = [Poller(self.cam, stop) for i in range(nb_pollers)]
+        for poller in pollers:
+            poller.start()
+        start = time.perf_counter()
+        self.interface.startAcq()
+        ready = self.cam.waitForFrame(nb_frames - 1, self.timeout)
+        elapsed = time.perf_counter() - start
+        # the last polls see the final count before the acquisition stops
+        time.sleep(0.01)
+        stop.set()
+        for poller in pollers:
+            poller.join()
+        self.interface.stopAcq()
+        if not ready:
+            raise RuntimeError('acquisition timed out: %s' % self.cam.getStatus())
+        return elapsed, pollers
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--replay', help='sequence file to replay, '
+                        'synthetic Bpp16 frames by default')
+    parser.add_argument('--pollers', type=int, default=8)
+    parser.add_argument('--frames', type=int, default=5000,
+                        help='frames per acquisition')
+    parser.add_argument('--runs', type=int, default=3,
+                        help='acquisitions per case, the best is reported')
+    args = parser.parse_args(argv[1:])
+
+    tmp_dir = None
+    file_name = args.replay
+    if not file_name:
+        tmp_dir = tempfile.mkdtemp(prefix='pointgrey_poll_')
+        file_name = os.path.join(tmp_dir, 'poll.pgr')
+        frames = PointGreyCompressionTest.make_frames('random', numpy.uint16, 16)
+        PointGreyCompressionTest.write_sequence(file_name, frames)
+
+    nb_errors = 0
+    try:
+        acq = PollAcq(file_name)
+        idle_time = min(acq.run_polled(args.frames, 0)[0] for i in range(args.runs))
+        polled_time = None
+        nb_polls = 0
+        for i in range(args.runs):
+            elapsed, pollers = acq.run_polled(args.frames, args.pollers)
+            for poller in pollers:
+                nb_errors += poller.nb_errors
+                if poller.last_nb_frames != args.frames:
+                    nb_errors += 1
+            if polled_time is None or elapsed < polled_time:
+                polled_time = elapsed
+                nb_polls = sum(poller.nb_polls for poller in pollers)
+        print('without pollers %.0f frames/s, with %d pollers %.0f frames/s '
+              '(%+.1f%%), %.0f polls/s: %s' %
+              (args.frames / idle_time, args.pollers, args.frames / polled_time,
+               (idle_time / polled_time - 1.) * 100., nb_polls / polled_time,
+               'ok' if not nb_errors else '%d errors' % nb_errors))
+    finally:
+        if tmp_dir:
+            os.remove(file_name)
+            os.rmdir(tmp_dir)
+    return 1 if nb_errors else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
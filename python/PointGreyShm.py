@@ -0,0 +1,147 @@
+############################################################################
+# This file is part of LImA, a Library for Image Acquisition
+#
+# Copyright (C) : 2009-2011
+# European Synchrotron Radiation Facility
+# BP 220, Grenoble 38043
+# FRANCE
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, see <http://www.gnu.org/licenses/>.
+############################################################################
+"""Reader of the PointGrey shared memory frame ring.
+
+Only needs numpy, so that viewers and feedback loops can follow the
+camera stream without Lima. The layout is described in PointGreyShm.h:
+a header, then slots made of a seqlock header and the frame data.
+"""
+import mmap
+import os
+import struct
+
+import numpy
+
+_HEADER = struct.Struct('<8s12iq')
+_SLOT = struct.Struct('<qq4i5d')
+_SEQ = struct.Struct('<q')
+_CLOSED_OFFSET = 44
+_WRITE_COUNT_OFFSET = 56
+SLOT_HEADER_SIZE = 128
+
+# lima::ImageType
+_DTYPES = {0: numpy.uint8, 1: numpy.int8,
+           2: numpy.uint16, 3: numpy.int16, 4: numpy.uint16, 5: numpy.int16,
+           6: numpy.uint16, 7: numpy.int16, 8: numpy.uint16, 9: numpy.int16,
+           10: numpy.uint32, 11: numpy.int32, 12: numpy.float32}
+
+FIELDS = ('frame_index', 'acq_frame_nb', 'frame_counter', 'gpio_state',
+          'seq_step', 'timestamp', 'camera_timestamp', 'synced_timestamp',
+          'exp_time', 'gain')
+
+
+class ShmReader(object):
+    """Follows a frame ring, never blocking the publisher.
+
+    Frames are numbered by the publisher from 0. A frame can be read
+    as long as it was not overwritten, nb_slots frames later.
+    """
+
+    def __init__(self, name=None):
+        self._map = None
+        self.nb_lost = 0
+        self._next = None
+        if name is not None:
+            self.attach(name)
+
+    def attach(self, name):
+        self.detach()
+        fd = os.open('/dev/shm/' + name.lstrip('/'), os.O_RDONLY)
+        try:
+            shm = mmap.mmap(fd, 0, mmap.MAP_SHARED, mmap.PROT_READ)
+        finally:
+            os.close(fd)
+        (magic, version, self.header_size, self.slot_size, self.nb_slots,
+         self.width, self.height, self.image_type, self.depth,
+         self.frame_size, closed, reserved0, reserved1, write_count) = \
+            _HEADER.unpack_from(shm, 0)
+        if magic != b'PGRYSHM1':
+            shm.close()
+            raise ValueError('%s is not a frame ring' % name)
+        self._map = shm
+        self.dtype = _DTYPES.get(self.image_type,
+                                 numpy.dtype('u%d' % self.depth))
+        self.nb_lost = 0
+        self._next = write_count
+
+    def detach(self):
+        """Frame views from get_frame(copy=False) must be released first."""
+        if self._map is not None:
+            self._map.close()
+            self._map = None
+
+    def is_closed(self):
+        """The publisher replaced the segment, attach again."""
+        return struct.unpack_from('<i', self._map, _CLOSED_OFFSET)[0] != 0
+
+    def write_count(self):
+        return _SEQ.unpack_from(self._map, _WRITE_COUNT_OFFSET)[0]
+
+    def _slot_offset(self, frame_index):
+        return self.header_size + (frame_index % self.nb_slots) * self.slot_size
+
+    def is_valid(self, frame_index):
+        seq = _SEQ.unpack_from(self._map, self._slot_offset(frame_index))[0]
+        return seq == 2 * (frame_index + 1)
+
+    def get_frame(self, frame_index, copy=True):
+        """(info, array) or None if not published yet or overwritten.
+
+        With copy=False the array is a view in the segment, check
+        is_valid(frame_index) once done with it.
+        """
+        if frame_index < 0 or not self.is_valid(frame_index):
+            return None
+        offset = self._slot_offset(frame_index)
+        fields = _SLOT.unpack_from(self._map, offset)
+        data = numpy.frombuffer(self._map, self.dtype,
+                                self.width * self.height,
+                                offset + SLOT_HEADER_SIZE)
+        data = data.reshape(self.height, self.width)
+        if copy:
+            data = data.copy()
+        if not self.is_valid(frame_index):
+            return None
+        return dict(zip(FIELDS, fields[1:])), data
+
+    def read_next(self, copy=True):
+        """Next frame after the last one read, None if none yet.
+
+        Frames overwritten before they could be read are counted in
+        nb_lost.
+        """
+        while True:
+            write_count = self.write_count()
+            if self._next >= write_count:
+                return None
+            oldest = write_count - self.nb_slots + 1
+            if self._next < oldest:
+                self.nb_lost += oldest - self._next
+                self._next = oldest
+            frame = self.get_frame(self._next, copy)
+            if frame is None:
+                # overwritten while reading, skip to a newer frame
+                self.nb_lost += 1
+                self._next += 1
+                continue
+            self._next += 1
+            return frame
@@ -0,0 +1,156 @@
+############################################################################
+# This file is part of LImA, a Library for Image Acquisition
+#
+# Copyright (C) : 2009-2011
+# European Synchrotron Radiation Facility
+# BP 220, Grenoble 38043
+# FRANCE
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, see <http://www.gnu.org/licenses/>.
+############################################################################
+"""Client of the PointGrey TCP frame stream.
+
+Only needs numpy; the lz4 module is used when installed, otherwise
+compressed frames are decoded in python. Run as a script to print the
+received frame rate:
+
+  python PointGreyStream.py host port
+"""
+import socket
+import struct
+import sys
+import time
+
+import numpy
+
+try:
+    import lz4.block as _lz4
+except ImportError:
+    _lz4 = None
+
+_HEADER = struct.Struct('<4s15i5d')
+
+# lima::ImageType
+_DTYPES = {0: numpy.uint8, 1: numpy.int8,
+           2: numpy.uint16, 3: numpy.int16, 4: numpy.uint16, 5: numpy.int16,
+           6: numpy.uint16, 7: numpy.int16, 8: numpy.uint16, 9: numpy.int16,
+           10: numpy.uint32, 11: numpy.int32, 12: numpy.float32}
+
+FIELDS = ('version', 'header_size', 'width', 'height', 'image_type', 'depth',
+          'compressed', 'payload_size', 'raw_size', 'acq_frame_nb',
+          'frame_counter', 'gpio_state', 'seq_step', 'nb_dropped',
+          'reserved', 'timestamp', 'camera_timestamp', 'synced_timestamp',
+          'exp_time', 'gain')
+
+
+def lz4_decompress(src, raw_size):
+    """Decode an LZ4 block."""
+    if _lz4 is not None:
+        return _lz4.decompress(src, uncompressed_size=raw_size)
+    src = bytearray(src)
+    dst = bytearray(raw_size)
+    ip = op = 0
+    end = len(src)
+    while ip < end:
+        token = src[ip]
+        ip += 1
+        length = token >> 4
+        if length == 15:
+            while True:
+                b = src[ip]
+                ip += 1
+                length += b
+                if b != 255:
+                    break
+        dst[op:op + length] = src[ip:ip + length]
+        ip += length
+        op += length
+        if ip >= end:
+            break
+        offset = src[ip] | (src[ip + 1] << 8)
+        ip += 2
+        length = token & 15
+        if length == 15:
+            while True:
+                b = src[ip]
+                ip += 1
+                length += b
+                if b != 255:
+                    break
+        length += 4
+        start = op - offset
+        if offset >= length:
+            dst[op:op + length] = dst[start:start + length]
+        else:
+            # overlapping match, repeats the last offset bytes
+            for i in range(length):
+                dst[op + i] = dst[start + i]
+        op += length
+    return bytes(dst)
+
+
+class StreamClient(object):
+
+    def __init__(self, host='localhost', port=0, timeout=None):
+        self._sock = socket.create_connection((host, port), timeout)
+
+    def close(self):
+        self._sock.close()
+
+    def _recv(self, size):
+        data = bytearray(size)
+        view = memoryview(data)
+        while size:
+            n = self._sock.recv_into(view, size)
+            if not n:
+                raise EOFError('stream closed by the server')
+            view = view[n:]
+            size -= n
+        return data
+
+    def read_frame(self):
+        """(info, array) of the next frame, blocks until it arrives."""
+        fields = _HEADER.unpack(bytes(self._recv(_HEADER.size)))
+        if fields[0] != b'PGST':
+            raise ValueError('not a PointGrey frame stream')
+        info = dict(zip(FIELDS, fields[1:]))
+        payload = self._recv(info['payload_size'])
+        if info['compressed']:
+            payload = lz4_decompress(bytes(payload), info['raw_size'])
+        dtype = _DTYPES.get(info['image_type'],
+                            numpy.dtype('u%d' % info['depth']))
+        data = numpy.frombuffer(payload, dtype)
+        return info, data.reshape(info['height'], info['width'])
+
+
+def main(argv):
+    host = argv[1] if len(argv) > 1 else 'localhost'
+    port = int(argv[2]) if len(argv) > 2 else 0
+    client = StreamClient(host, port)
+    nb_frames = 0
+    start = time.time()
+    while True:
+        info, data = client.read_frame()
+        nb_frames += 1
+        elapsed = time.time() - start
+        if elapsed >= 1.:
+            print('frame %d %dx%d: %.1f frames/s, %d dropped' %
+                  (info['acq_frame_nb'], info['width'], info['height'],
+                   nb_frames / elapsed, info['nb_dropped']))
+            nb_frames = 0
+            start = time.time()
+
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -0,0 +1,308 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "lima/Timestamp.h"
+#include "PointGreyAccumulator.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+// row kernels
+//-----------------------------------------------------
+#ifdef __SSE2__
+static inline void _add4(unsigned int *dst, __m128i value, bool first)
+{
+    __m128i *p = (__m128i *) dst;
+    if (!first)
+        value = _mm_add_epi32(value, _mm_loadu_si128(p));
+    _mm_storeu_si128(p, value);
+}
+
+// vector part of the row, returns the number of pixels done
+static int _addVector(const unsigned char *src, unsigned int *dst, int width,
+                      unsigned int level, bool first, int& nb_saturated)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vlevel = _mm_set1_epi8(char(level));
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + x));
+        // SSE2 has no unsigned compare: v >= level when level - v saturates to 0
+        __m128i saturated = _mm_cmpeq_epi8(_mm_subs_epu8(vlevel, v), zero);
+        nb_saturated += __builtin_popcount(_mm_movemask_epi8(saturated));
+
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        _add4(dst + x, _mm_unpacklo_epi16(lo, zero), first);
+        _add4(dst + x + 4, _mm_unpackhi_epi16(lo, zero), first);
+        _add4(dst + x + 8, _mm_unpacklo_epi16(hi, zero), first);
+        _add4(dst + x + 12, _mm_unpackhi_epi16(hi, zero), first);
+    }
+    return x;
+}
+
+static int _addVector(const unsigned short *src, unsigned int *dst, int width,
+                      unsigned int level, bool first, int& nb_saturated)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vlevel = _mm_set1_epi16(short(level));
+    int nb_bits = 0;
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + x));
+        __m128i saturated = _mm_cmpeq_epi16(_mm_subs_epu16(vlevel, v), zero);
+        nb_bits += __builtin_popcount(_mm_movemask_epi8(saturated));
+
+        _add4(dst + x, _mm_unpacklo_epi16(v, zero), first);
+        _add4(dst + x + 4, _mm_unpackhi_epi16(v, zero), first);
+    }
+    // two mask bits per pixel
+    nb_saturated += nb_bits / 2;
+    return x;
+}
+#endif
+
+template <class SrcT>
+static int _addRow(const SrcT *src, unsigned int *dst, int width, unsigned int level, bool first)
+{
+    int nb_saturated = 0;
+    int x = 0;
+#ifdef __SSE2__
+    x = _addVector(src, dst, width, level, first, nb_saturated);
+#endif
+    for (; x < width; ++x)
+    {
+        unsigned int value = src[x];
+        if (value >= level)
+            ++nb_saturated;
+        dst[x] = first ? value : dst[x] + value;
+    }
+    return nb_saturated;
+}
+
+template <class SrcT>
+static int _addRows(const void *src, int src_stride, void *dst, int width,
+                    int row_begin, int row_end, unsigned int level, bool first)
+{
+    const char *src_row = (const char *) src + row_begin * src_stride;
+    unsigned int *dst_row = (unsigned int *) dst + row_begin * width;
+    int nb_saturated = 0;
+    for (int row = row_begin; row < row_end; ++row)
+    {
+        nb_saturated += _addRow((const SrcT *) src_row, dst_row, width, level, first);
+        src_row += src_stride;
+        dst_row += width;
+    }
+    return nb_saturated;
+}
+
+//-----------------------------------------------------
+// _Job class
+//-----------------------------------------------------
+class Accumulator::_Job : public WorkerPool::Job
+{
+public:
+    _Job(Accumulator& acc, const void *src, int src_stride, void *dst, bool first)
+        : m_acc(acc), m_src(src), m_src_stride(src_stride), m_dst(dst), m_first(first)
+    {}
+
+    virtual void run(int part, int nb_parts)
+    {
+        int width = m_acc.m_size.getWidth();
+        int height = m_acc.m_size.getHeight();
+        int row_begin = height * part / nb_parts;
+        int row_end = height * (part + 1) / nb_parts;
+
+        int& nb_saturated = m_acc.m_part_nb_saturated[part];
+        if (m_acc.m_src_type == Bpp8)
+            nb_saturated = _addRows<unsigned char>(m_src, m_src_stride, m_dst, width,
+                                                           row_begin, row_end,
+                                                           m_acc.m_level, m_first);
+        else
+            nb_saturated = _addRows<unsigned short>(m_src, m_src_stride, m_dst, width,
+                                                            row_begin, row_end,
+                                                            m_acc.m_level, m_first);
+    }
+
+    int getNbSaturated() const
+    {
+        int nb_saturated = 0;
+        for (unsigned int i = 0; i < m_acc.m_part_nb_saturated.size(); ++i)
+            nb_saturated += m_acc.m_part_nb_saturated[i];
+        return nb_saturated;
+    }
+
+private:
+    Accumulator& m_acc;
+    const void *m_src;
+    int m_src_stride;
+    void *m_dst;
+    bool m_first;
+};
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Accumulator::Accumulator()
+    : m_nb_sub_frames(1),
+      m_saturation_level(0),
+      m_src_type(Bpp16),
+      m_level(0),
+      m_nb_accumulated(0),
+      m_nb_saturated_sub_frames(0),
+      m_max_saturated_pixels(0)
+{
+    DEB_CONSTRUCTOR();
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_part_nb_saturated.assign(getNbThreads(), 0);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Accumulator::~Accumulator()
+{
+    DEB_DESTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Accumulator::setNbSubFrames(int nb_sub_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_sub_frames);
+    if (nb_sub_frames < 1 || nb_sub_frames > k_MaxNbSubFrames)
+        THROW_HW_ERROR(InvalidValue) << "Number of sub-frames must be in [1, "
+                                     << k_MaxNbSubFrames << "]";
+    m_nb_sub_frames = nb_sub_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Accumulator::setNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+    m_pool.setNbThreads(nb_threads);
+    m_part_nb_saturated.assign(getNbThreads(), 0);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Accumulator::setSaturationLevel(int level)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(level);
+    if (level < 0 || level > 65535)
+        THROW_HW_ERROR(InvalidValue) << "Saturation level must be in [0, 65535]";
+    m_saturation_level = level;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Accumulator::prepare(const Size& size, ImageType src_type)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(size, src_type);
+    unsigned int full_scale;
+    switch (src_type)
+    {
+    case Bpp8:
+        full_scale = 255;
+        break;
+    case Bpp16:
+        full_scale = 65535;
+        break;
+    default:
+        THROW_HW_ERROR(NotSupported) << "Accumulation not supported for " << DEB_VAR1(src_type);
+    }
+    if (unsigned(m_saturation_level) > full_scale)
+        THROW_HW_ERROR(Error) << "Saturation level " << m_saturation_level
+                              << " above the sub-frame full scale " << full_scale;
+
+    m_size = size;
+    m_src_type = src_type;
+    m_level = m_saturation_level ? m_saturation_level : full_scale;
+    m_nb_accumulated = 0;
+    m_nb_saturated_sub_frames = 0;
+    m_max_saturated_pixels = 0;
+    m_part_nb_saturated.assign(getNbThreads(), 0);
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_published_stats.store(m_stats);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool Accumulator::add(const void *src, int src_stride, void *dst)
+{
+    double start = Timestamp::now();
+    bool first = isFrameStart();
+    if (first)
+    {
+        m_nb_accumulated = 0;
+        m_nb_saturated_sub_frames = 0;
+        m_max_saturated_pixels = 0;
+    }
+
+    _Job job(*this, src, src_stride, dst, first);
+    m_pool.run(job);
+
+    int nb_saturated = job.getNbSaturated();
+    if (nb_saturated)
+    {
+        ++m_nb_saturated_sub_frames;
+        ++m_stats.nb_saturated_sub_frames;
+        m_stats.nb_saturated_pixels += nb_saturated;
+        if (nb_saturated > m_max_saturated_pixels)
+            m_max_saturated_pixels = nb_saturated;
+    }
+    ++m_nb_accumulated;
+
+    double elapsed = Timestamp::now() - start;
+    m_stats.mean_time += (elapsed - m_stats.mean_time) / ++m_stats.nb_sub_frames;
+    bool complete = (m_nb_accumulated == m_nb_sub_frames);
+    if (complete)
+        ++m_stats.nb_frames;
+    m_published_stats.store(m_stats);
+    return complete;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Accumulator::getStats(Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_published_stats.load(stats);
+}
@@ -0,0 +1,443 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <math.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "lima/Timestamp.h"
+#include "PointGreyBeamAnalyzer.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+// row kernels
+//-----------------------------------------------------
+#ifdef __SSE2__
+static inline void _load8(const unsigned char *src, __m128& lo, __m128& hi)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) src), zero);
+    lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+    hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+}
+
+static inline void _load8(const unsigned short *src, __m128& lo, __m128& hi)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_loadu_si128((const __m128i *) src);
+    lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+    hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+}
+
+// the signed conversion only holds 31 bits: convert the 16 bit halves
+static inline __m128 _load4(const unsigned int *src)
+{
+    const __m128i low_mask = _mm_set1_epi32(0xffff);
+    __m128i v = _mm_loadu_si128((const __m128i *) src);
+    __m128 hi = _mm_cvtepi32_ps(_mm_srli_epi32(v, 16));
+    __m128 lo = _mm_cvtepi32_ps(_mm_and_si128(v, low_mask));
+    return _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.f)), lo);
+}
+
+static inline void _load8(const unsigned int *src, __m128& lo, __m128& hi)
+{
+    lo = _load4(src);
+    hi = _load4(src + 4);
+}
+
+static inline void _addColumns(double *col, __m128 value)
+{
+    __m128d lo = _mm_cvtps_pd(value);
+    __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(value, value));
+    _mm_storeu_pd(col, _mm_add_pd(_mm_loadu_pd(col), lo));
+    _mm_storeu_pd(col + 2, _mm_add_pd(_mm_loadu_pd(col + 2), hi));
+}
+#endif
+
+// add the row to the column projection, returns the row sum
+template <class SrcT>
+static double _projectRow(const SrcT *src, const float *background, float threshold,
+                          double *col, int width)
+{
+    double row_sum = 0.;
+    int x = 0;
+#ifdef __SSE2__
+    const __m128 vthreshold = _mm_set1_ps(threshold);
+    __m128 vsum = _mm_setzero_ps();
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128 lo, hi;
+        _load8(src + x, lo, hi);
+        lo = _mm_sub_ps(lo, _mm_loadu_ps(background + x));
+        hi = _mm_sub_ps(hi, _mm_loadu_ps(background + x + 4));
+        lo = _mm_and_ps(lo, _mm_cmpge_ps(lo, vthreshold));
+        hi = _mm_and_ps(hi, _mm_cmpge_ps(hi, vthreshold));
+        vsum = _mm_add_ps(vsum, _mm_add_ps(lo, hi));
+        _addColumns(col + x, lo);
+        _addColumns(col + x + 4, hi);
+    }
+    float sums[4];
+    _mm_storeu_ps(sums, vsum);
+    row_sum = double(sums[0]) + sums[1] + sums[2] + sums[3];
+#endif
+    for (; x < width; ++x)
+    {
+        float value = float(src[x]) - background[x];
+        if (!(value >= threshold))
+            continue;
+        row_sum += value;
+        col[x] += value;
+    }
+    return row_sum;
+}
+
+template <class SrcT>
+static void _projectRows(const void *src, int src_stride, const float *background, float threshold,
+                         double *row_proj, double *col_proj, int width, int row_begin, int row_end)
+{
+    const char *src_row = (const char *) src + row_begin * src_stride;
+    for (int row = row_begin; row < row_end; ++row)
+    {
+        row_proj[row] = _projectRow((const SrcT *) src_row, background + row * width,
+                                    threshold, col_proj, width);
+        src_row += src_stride;
+    }
+}
+
+//-----------------------------------------------------
+// _Job class
+//-----------------------------------------------------
+class BeamAnalyzer::_Job : public WorkerPool::Job
+{
+public:
+    _Job(BeamAnalyzer& analyzer, const void *src, int src_stride)
+        : m_analyzer(analyzer), m_src(src), m_src_stride(src_stride)
+    {}
+
+    virtual void run(int part, int nb_parts)
+    {
+        int width = m_analyzer.m_size.getWidth();
+        int height = m_analyzer.m_size.getHeight();
+        int row_begin = height * part / nb_parts;
+        int row_end = height * (part + 1) / nb_parts;
+        const float *background = &m_analyzer.m_background[0];
+        float threshold = float(m_analyzer.m_threshold);
+        double *row_proj = &m_analyzer.m_row_proj[0];
+        std::vector<double>& col_proj = m_analyzer.m_col_proj[part];
+        col_proj.assign(width, 0.);
+
+        switch (m_analyzer.m_type)
+        {
+        case Bpp8:
+            _projectRows<unsigned char>(m_src, m_src_stride, background, threshold,
+                                        row_proj, &col_proj[0], width, row_begin, row_end);
+            break;
+        case Bpp16:
+            _projectRows<unsigned short>(m_src, m_src_stride, background, threshold,
+                                         row_proj, &col_proj[0], width, row_begin, row_end);
+            break;
+        default:
+            _projectRows<unsigned int>(m_src, m_src_stride, background, threshold,
+                                       row_proj, &col_proj[0], width, row_begin, row_end);
+        }
+    }
+
+private:
+    BeamAnalyzer& m_analyzer;
+    const void *m_src;
+    int m_src_stride;
+};
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+BeamAnalyzer::BeamAnalyzer()
+    : m_background_level(0.),
+      m_threshold(0.),
+      m_series_size(4096),
+      m_type(Bpp16),
+      m_write_count(0)
+{
+    DEB_CONSTRUCTOR();
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+BeamAnalyzer::~BeamAnalyzer()
+{
+    DEB_DESTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BeamAnalyzer::setBackgroundMap(const float *map, const Size& size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(size);
+    m_background_map.assign(map, map + size.getWidth() * size.getHeight());
+    m_background_size = size;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BeamAnalyzer::clearBackgroundMap()
+{
+    DEB_MEMBER_FUNCT();
+    m_background_map.clear();
+    m_background_size = Size();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BeamAnalyzer::setBackgroundLevel(double level)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(level);
+    m_background_level = level;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BeamAnalyzer::setThreshold(double threshold)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(threshold);
+    if (threshold < 0.)
+        THROW_HW_ERROR(InvalidValue) << "Threshold must be positive";
+    m_threshold = threshold;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BeamAnalyzer::setSeriesSize(int nb_results)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_results);
+    if (nb_results < 1)
+        THROW_HW_ERROR(InvalidValue) << "Series size must be at least 1";
+    m_series_size = nb_results;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BeamAnalyzer::prepare(const Size& size, ImageType type)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(size, type);
+    if (type != Bpp8 && type != Bpp16 && type != Bpp32)
+        THROW_HW_ERROR(NotSupported) << "Beam analysis not supported for " << DEB_VAR1(type);
+
+    int nb_pixels = size.getWidth() * size.getHeight();
+    if (m_background_map.empty())
+        m_background.assign(nb_pixels, float(m_background_level));
+    else if (m_background_size == size)
+        m_background = m_background_map;
+    else
+        THROW_HW_ERROR(Error) << "Background map size " << m_background_size
+                              << " does not match the frame size " << size;
+
+    m_size = size;
+    m_type = type;
+    m_row_proj.assign(size.getHeight(), 0.);
+    m_col_proj.resize(getNbThreads());
+
+    // zero seq marks the slots empty
+    _Slot empty;
+    memset(&empty, 0, sizeof(empty));
+    m_series.assign(m_series_size, empty);
+    __atomic_store_n(&m_write_count, 0, __ATOMIC_RELEASE);
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BeamAnalyzer::process(const void *src, int src_stride, int acq_frame_nb,
+                           double timestamp, double synced_timestamp)
+{
+    double start = Timestamp::now();
+    _Job job(*this, src, src_stride);
+    m_pool.run(job);
+
+    // parts wrote their own rows and columns
+    std::vector<double>& col_proj = m_col_proj[0];
+    for (unsigned int part = 1; part < m_col_proj.size(); ++part)
+        for (unsigned int x = 0; x < col_proj.size(); ++x)
+            col_proj[x] += m_col_proj[part][x];
+
+    Result result;
+    result.acq_frame_nb = acq_frame_nb;
+    result.timestamp = timestamp;
+    result.synced_timestamp = synced_timestamp;
+    _profile(col_proj, result.intensity, result.centroid_x, result.rms_x, result.fwhm_x);
+    _profile(m_row_proj, result.intensity, result.centroid_y, result.rms_y, result.fwhm_y);
+
+    long long index = m_write_count;
+    _Slot& slot = m_series[index % m_series.size()];
+    __atomic_store_n(&slot.seq, 2 * index + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot.result = result;
+    __atomic_store_n(&slot.seq, 2 * (index + 1), __ATOMIC_RELEASE);
+    __atomic_store_n(&m_write_count, index + 1, __ATOMIC_RELEASE);
+
+    double elapsed = Timestamp::now() - start;
+    m_stats.mean_time += (elapsed - m_stats.mean_time) / ++m_stats.nb_frames;
+    if (elapsed > m_stats.max_time)
+        m_stats.max_time = elapsed;
+}
+
+//-----------------------------------------------------
+// first and second moments and full width at half maximum
+//-----------------------------------------------------
+void BeamAnalyzer::_profile(const std::vector<double>& proj, double& sum,
+                            double& centroid, double& rms, double& fwhm)
+{
+    int nb_values = proj.size();
+    double sum_x = 0.;
+    int peak = 0;
+    sum = 0.;
+    for (int i = 0; i < nb_values; ++i)
+    {
+        sum += proj[i];
+        sum_x += i * proj[i];
+        if (proj[i] > proj[peak])
+            peak = i;
+    }
+    if (sum <= 0.)
+    {
+        centroid = rms = fwhm = 0.;
+        return;
+    }
+    centroid = sum_x / sum;
+
+    double sum_d2 = 0.;
+    for (int i = 0; i < nb_values; ++i)
+    {
+        double d = i - centroid;
+        sum_d2 += d * d * proj[i];
+    }
+    rms = sqrt(sum_d2 / sum);
+
+    // half maximum crossings on both sides of the peak, interpolated
+    double half = proj[peak] / 2;
+    double left = 0., right = nb_values - 1;
+    for (int i = peak; i > 0; --i)
+        if (proj[i - 1] <= half)
+        {
+            left = i - 1 + (half - proj[i - 1]) / (proj[i] - proj[i - 1]);
+            break;
+        }
+    for (int i = peak; i < nb_values - 1; ++i)
+        if (proj[i + 1] <= half)
+        {
+            right = i + (proj[i] - half) / (proj[i] - proj[i + 1]);
+            break;
+        }
+    fwhm = right - left;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+long long BeamAnalyzer::getWriteCount() const
+{
+    return __atomic_load_n(&m_write_count, __ATOMIC_ACQUIRE);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool BeamAnalyzer::getResult(long long index, Result& result) const
+{
+    if (index < 0 || m_series.empty())
+        return false;
+    const _Slot& slot = m_series[index % m_series.size()];
+    long long seq = 2 * (index + 1);
+    if (__atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE) != seq)
+        return false;
+    result = slot.result;
+    // the copy is only consistent if seq did not move
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot.seq, __ATOMIC_RELAXED) == seq;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool BeamAnalyzer::getLastResult(Result& result) const
+{
+    long long count = getWriteCount();
+    return count && getResult(count - 1, result);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BeamAnalyzer::getSeries(long long first, int max_nb, std::string& data) const
+{
+    long long count = getWriteCount();
+    long long oldest = count - (long long) m_series.size();
+    if (first < oldest)
+        first = oldest;
+    if (first < 0)
+        first = 0;
+    long long end = first + max_nb;
+    if (end > count)
+        end = count;
+
+    data.clear();
+    if (end > first)
+        data.reserve((end - first) * k_NbFields * sizeof(double));
+    for (long long index = first; index < end; ++index)
+    {
+        Result result;
+        // overwritten while reading, skipped
+        if (!getResult(index, result))
+            continue;
+        double record[k_NbFields] = {
+            double(result.acq_frame_nb), result.timestamp, result.synced_timestamp,
+            result.intensity, result.centroid_x, result.centroid_y,
+            result.rms_x, result.rms_y, result.fwhm_x, result.fwhm_y
+        };
+        data.append((const char *) record, sizeof(record));
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BeamAnalyzer::getStats(Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    stats = m_stats;
+}
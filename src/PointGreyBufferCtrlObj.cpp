@@ -0,0 +1,460 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "lima/Timestamp.h"
+#include "PointGreyBufferCtrlObj.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+static const size_t k_FrameAlign = 4096;
+static const size_t k_2M = size_t(1) << 21;
+static const size_t k_1G = size_t(1) << 30;
+
+static size_t _roundUp(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+HugePageAllocMgr::HugePageAllocMgr()
+    : m_page_mode(TransparentHugePages)
+    , m_lock(true)
+    , m_nb_buffers(0)
+    , m_frame_stride(0)
+    , m_alloc_mode(NormalPages)
+    , m_data(NULL)
+    , m_size(0)
+    , m_nb_pins(0)
+{
+    DEB_CONSTRUCTOR();
+    memset(&m_info, 0, sizeof(m_info));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+HugePageAllocMgr::~HugePageAllocMgr()
+{
+    DEB_DESTRUCTOR();
+    if (m_nb_pins)
+        DEB_ERROR() << m_nb_pins << " frame buffer views are still alive";
+    _release();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HugePageAllocMgr::allocBuffers(int nb_buffers, const FrameDim& frame_dim)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR3(nb_buffers, frame_dim, m_page_mode);
+
+    if (m_data && nb_buffers == m_nb_buffers && frame_dim == m_frame_dim &&
+        m_page_mode == m_alloc_mode)
+        return;
+    _checkNotPinned();
+    _release();
+
+    if (nb_buffers <= 0 || !frame_dim.isValid())
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR2(nb_buffers, frame_dim);
+
+    size_t frame_stride = _roundUp(frame_dim.getMemSize(), k_FrameAlign);
+    size_t size = frame_stride * nb_buffers;
+
+    // fall back to smaller pages when the hugetlbfs pool is short, PageMode
+    // values are ordered by page size
+    PageMode mode = m_page_mode;
+    while (!_map(mode, size))
+    {
+        if (mode == NormalPages)
+            THROW_HW_ERROR(Error) << "Failed to allocate " << size << " bytes of frame buffers: "
+                                  << strerror(errno);
+        DEB_WARNING() << "Page mode " << mode << " not available: " << strerror(errno);
+        mode = PageMode(mode - 1);
+    }
+
+    m_frame_dim = frame_dim;
+    m_nb_buffers = nb_buffers;
+    m_frame_stride = frame_stride;
+    m_alloc_mode = m_page_mode;
+    m_pins.assign(nb_buffers, 0);
+    m_info.page_mode = mode;
+    m_info.prefaulted = m_info.locked = false;
+    m_info.prefault_time = 0.;
+    DEB_TRACE() << "Allocated " << m_info.nb_bytes << " bytes with page mode " << mode;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool HugePageAllocMgr::_map(PageMode mode, size_t size)
+{
+    DEB_MEMBER_FUNCT();
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    switch (mode)
+    {
+    case HugePages1G:
+        flags |= MAP_HUGETLB | MAP_HUGE_1GB;
+        page_size = k_1G;
+        break;
+    case HugePages2M:
+        flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+        page_size = k_2M;
+        break;
+    case TransparentHugePages:
+        page_size = k_2M;
+        break;
+    default:
+        break;
+    }
+
+    size = _roundUp(size, page_size);
+    // transparent huge pages need a 2 MiB aligned range, over-map and trim
+    size_t map_size = (mode == TransparentHugePages) ? size + page_size : size;
+    void *ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (ptr == MAP_FAILED)
+        return false;
+
+    char *data = (char *) ptr;
+    if (mode == TransparentHugePages)
+    {
+        char *aligned = (char *) _roundUp(size_t(data), page_size);
+        if (aligned != data)
+            munmap(data, aligned - data);
+        munmap(aligned + size, data + map_size - (aligned + size));
+        data = aligned;
+        if (madvise(data, size, MADV_HUGEPAGE) < 0)
+        {
+            int err = errno;
+            munmap(data, size);
+            errno = err;
+            return false;
+        }
+    }
+
+    m_data = data;
+    m_size = size;
+    m_info.page_size = page_size;
+    m_info.nb_bytes = size;
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+const FrameDim& HugePageAllocMgr::getFrameDim()
+{
+    return m_frame_dim;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HugePageAllocMgr::getNbBuffers(int& nb_buffers)
+{
+    nb_buffers = m_nb_buffers;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HugePageAllocMgr::releaseBuffers()
+{
+    DEB_MEMBER_FUNCT();
+    _checkNotPinned();
+    _release();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HugePageAllocMgr::_checkNotPinned()
+{
+    DEB_MEMBER_FUNCT();
+    if (m_nb_pins)
+        THROW_HW_ERROR(Error) << "Frame buffers are still viewed: " << m_nb_pins << " pins";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HugePageAllocMgr::_release()
+{
+    DEB_MEMBER_FUNCT();
+    if (!m_data)
+        return;
+    // unmapping also unlocks
+    munmap(m_data, m_size);
+    m_data = NULL;
+    m_size = 0;
+    m_nb_buffers = 0;
+    m_frame_dim = FrameDim();
+    m_pins.clear();
+    memset(&m_info, 0, sizeof(m_info));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void *HugePageAllocMgr::getBufferPtr(int buffer_nb)
+{
+    DEB_MEMBER_FUNCT();
+    if (buffer_nb < 0 || buffer_nb >= m_nb_buffers)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(buffer_nb);
+    return m_data + buffer_nb * m_frame_stride;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HugePageAllocMgr::prefault()
+{
+    DEB_MEMBER_FUNCT();
+    if (!m_data)
+        return;
+    if (m_page_mode != m_alloc_mode)
+    {
+        // Lima only reallocates on a geometry change, apply the new page mode here
+        FrameDim frame_dim = m_frame_dim;
+        allocBuffers(m_nb_buffers, frame_dim);
+    }
+    if (m_info.prefaulted)
+        return;
+
+    double start = Timestamp::now();
+    // one write per base page, hugetlbfs and THP fault a whole huge page at once
+    size_t step = sysconf(_SC_PAGESIZE);
+    volatile char *data = m_data;
+    for (size_t offset = 0; offset < m_size; offset += step)
+        data[offset] = 0;
+
+    if (m_lock)
+    {
+        if (mlock(m_data, m_size) == 0)
+            m_info.locked = true;
+        else
+            DEB_WARNING() << "Failed to lock " << m_size << " bytes of frame buffers: "
+                          << strerror(errno);
+    }
+    m_info.prefaulted = true;
+    m_info.prefault_time = Timestamp::now() - start;
+    DEB_TRACE() << "Pre-faulted " << m_size << " bytes in " << m_info.prefault_time << " s"
+                << (m_info.locked ? ", locked" : "");
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HugePageAllocMgr::pinBuffer(int buffer_nb)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_pin_cond.mutex());
+    if (buffer_nb < 0 || buffer_nb >= int(m_pins.size()))
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(buffer_nb);
+    ++m_pins[buffer_nb];
+    ++m_nb_pins;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HugePageAllocMgr::unpinBuffer(int buffer_nb)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_pin_cond.mutex());
+    if (buffer_nb < 0 || buffer_nb >= int(m_pins.size()) || !m_pins[buffer_nb])
+        THROW_HW_ERROR(InvalidValue) << "Buffer not pinned: " << DEB_VAR1(buffer_nb);
+    --m_pins[buffer_nb];
+    --m_nb_pins;
+    m_pin_cond.broadcast();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool HugePageAllocMgr::waitUnpinned(int buffer_nb, double timeout)
+{
+    DEB_MEMBER_FUNCT();
+    double deadline = Timestamp::now() + timeout;
+    AutoMutex lock(m_pin_cond.mutex());
+    while (m_pins[buffer_nb])
+    {
+        double now = Timestamp::now();
+        if (now >= deadline)
+            return false;
+        m_pin_cond.wait(deadline - now);
+    }
+    return true;
+}
+
+//-----------------------------------------------------
+// BufferCtrlObj
+//-----------------------------------------------------
+BufferCtrlObj::BufferCtrlObj()
+    : m_cb_mgr(m_alloc_mgr)
+    , m_mgr(m_cb_mgr)
+{
+    DEB_CONSTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+BufferCtrlObj::~BufferCtrlObj()
+{
+    DEB_DESTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::setFrameDim(const FrameDim& frame_dim)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.setFrameDim(frame_dim);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::getFrameDim(FrameDim& frame_dim)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.getFrameDim(frame_dim);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::setNbBuffers(int nb_buffers)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.setNbBuffers(nb_buffers);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::getNbBuffers(int& nb_buffers)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.getNbBuffers(nb_buffers);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::setNbConcatFrames(int nb_concat_frames)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.setNbConcatFrames(nb_concat_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::getNbConcatFrames(int& nb_concat_frames)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.getNbConcatFrames(nb_concat_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::getMaxNbBuffers(int& max_nb_buffers)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.getMaxNbBuffers(max_nb_buffers);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void *BufferCtrlObj::getBufferPtr(int buffer_nb, int concat_frame_nb)
+{
+    DEB_MEMBER_FUNCT();
+    return m_mgr.getBufferPtr(buffer_nb, concat_frame_nb);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void *BufferCtrlObj::getFramePtr(int acq_frame_nb)
+{
+    DEB_MEMBER_FUNCT();
+    return m_mgr.getFramePtr(acq_frame_nb);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::getStartTimestamp(Timestamp& start_ts)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.getStartTimestamp(start_ts);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::getFrameInfo(int acq_frame_nb, HwFrameInfoType& info)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.getFrameInfo(acq_frame_nb, info);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::registerFrameCallback(HwFrameCallback& frame_cb)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.registerFrameCallback(frame_cb);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void BufferCtrlObj::unregisterFrameCallback(HwFrameCallback& frame_cb)
+{
+    DEB_MEMBER_FUNCT();
+    m_mgr.unregisterFrameCallback(frame_cb);
+}
@@ -1,3 +1,10 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 #include "PointGreyCamera.h"
 
 using namespace lima;
@@ -16,30 +23,49 @@ public:
 protected:
     virtual void threadFunction();
 private:
+    template <class CameraType>
+    void _grabLoop(CameraType *camera);
+    void _replayLoop();
+    void _callbackLoop();
+
     Camera &m_cam;
 };
 
+// HDR register sets, used to run a 2 or 4 step exposure/gain sequence on-device
+static const unsigned int k_HDRCtrlReg = 0x1800;
+static const unsigned int k_HDRShutterReg = 0x1820;
+static const unsigned int k_HDRGainReg = 0x1824;
+static const unsigned int k_HDRSetOffset = 0x20;
+static const unsigned int k_HDRNbSets = 4;
+static const unsigned int k_HDRPresent = 0x80000000;
+static const unsigned int k_HDROn = 0x02000000;
+// embedded shutter and gain carry the raw register value in the low 12 bits
+static const unsigned int k_EmbeddedValueMask = 0xfff;
+
+// GPIO lines available on the camera connector
+static const int k_NbGpioPins = 4;
+// the embedded 1394 cycle timer wraps every 128 s
+static const double k_CycleTimerPeriod = 128.;
+
+// GigE Vision bootstrap registers, IEEE 1588 is bit 12 of both
+static const unsigned int k_GVCPCapabilityReg = 0x0934;
+static const unsigned int k_GVCPConfigReg = 0x0954;
+static const unsigned int k_GVCPPtpBit = 0x80000000 >> 12;
+
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
 Camera::Camera(const int camera_serial,
                const int packet_size,
                const int packet_delay)
-    : m_nb_frames(1)
-    , m_status(Ready)
-    , m_quit(false)
-    , m_acq_started(false)
-    , m_thread_running(true)
-    , m_image_number(0)
-    , m_camera(NULL)
 {
     DEB_CONSTRUCTOR();
+    _init();
 
     FlyCapture2::BusManager busmgr;
     FlyCapture2::PGRGuid pgrguid;
 
     unsigned int nb_cameras;
-    m_camera = new Camera_t();
 
     m_error = busmgr.GetNumOfCameras(&nb_cameras);
     if (m_error != FlyCapture2::PGRERROR_OK)
@@ -52,6 +78,16 @@ Camera::Camera(const int camera_serial,
     if (m_error != FlyCapture2::PGRERROR_OK)
         THROW_HW_ERROR(Error) << "Camera not found: " << m_error.GetDescription();
 
+    FlyCapture2::InterfaceType interface_type;
+    m_error = busmgr.GetInterfaceTypeFromGuid(&pgrguid, &interface_type);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to get camera interface type: " << m_error.GetDescription();
+
+    if (interface_type == FlyCapture2::INTERFACE_GIGE)
+        m_camera = m_gige_camera = new FlyCapture2::GigECamera();
+    else
+        m_camera = m_format7_camera = new FlyCapture2::Camera();
+
     m_error = m_camera->Connect(&pgrguid);
     if (m_error != FlyCapture2::PGRERROR_OK)
         THROW_HW_ERROR(Error) << "Failed to connect to camera: " << m_error.GetDescription();
@@ -60,10 +96,18 @@ Camera::Camera(const int camera_serial,
     if (m_error != FlyCapture2::PGRERROR_OK)
         THROW_HW_ERROR(Error) << "Failed to get camera info: " << m_error.GetDescription();
 
-    if (packet_size > 0)
+    m_error = m_camera->GetConfiguration(&m_config);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to get camera configuration: " << m_error.GetDescription();
+
+    char shm_name[64];
+    snprintf(shm_name, sizeof(shm_name), "/pointgrey_%d", camera_serial);
+    m_shm_publisher.setName(shm_name);
+
+    if (m_gige_camera && packet_size > 0)
         setPacketSize(packet_size);
 
-    if (packet_delay > 0)
+    if (m_gige_camera && packet_delay > 0)
         setPacketDelay(packet_delay);
 
     _getImageSettingsInfo();
@@ -82,6 +126,116 @@ Camera::Camera(const int camera_serial,
     m_acq_thread->start();
 }
 
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Camera::Camera(const std::string& replay_file)
+{
+    DEB_CONSTRUCTOR();
+    _init();
+    m_replay_active = true;
+    DEB_PARAM() << DEB_VAR1(replay_file);
+
+    m_replay.open(replay_file);
+    FrameDim frame_dim = m_replay.getFrameDim();
+
+    strcpy(m_camera_info.vendorName, "Point Grey Research");
+    strcpy(m_camera_info.modelName, "Replay");
+    m_camera_info.interfaceType = FlyCapture2::INTERFACE_UNKNOWN;
+    m_shm_publisher.setName("/pointgrey_replay");
+
+    m_config.numBuffers = 10;
+    m_config.grabMode = FlyCapture2::DROP_FRAMES;
+    m_config.grabTimeout = FlyCapture2::TIMEOUT_INFINITE;
+    m_config.highPerformanceRetrieveBuffer = false;
+
+    m_image_settings_info.maxWidth = frame_dim.getSize().getWidth();
+    m_image_settings_info.maxHeight = frame_dim.getSize().getHeight();
+
+    m_image_settings.offsetX = 0;
+    m_image_settings.offsetY = 0;
+    m_image_settings.width = m_image_settings_info.maxWidth;
+    m_image_settings.height = m_image_settings_info.maxHeight;
+    switch (frame_dim.getImageType())
+    {
+    case Bpp8:
+        m_image_settings.pixelFormat = FlyCapture2::PIXEL_FORMAT_MONO8;
+        break;
+    case Bpp16:
+        m_image_settings.pixelFormat = FlyCapture2::PIXEL_FORMAT_MONO16;
+        break;
+    default:
+        THROW_HW_ERROR(Error) << "Unsupported image type in " << replay_file;
+    }
+
+    _SimProperty shutter = {10., 0.01, 1000., false};
+    _SimProperty gain = {0., 0., 24., false};
+    _SimProperty frame_rate = {30., 1., 1E5, false};
+    m_sim_properties[FlyCapture2::SHUTTER] = shutter;
+    m_sim_properties[FlyCapture2::GAIN] = gain;
+    m_sim_properties[FlyCapture2::FRAME_RATE] = frame_rate;
+
+    //Acquisition  Thread
+    m_acq_thread = new _AcqThread(*this);
+    m_acq_thread->start();
+}
+
+//-----------------------------------------------------
+// member state shared by both constructors
+//-----------------------------------------------------
+void Camera::_init()
+{
+    m_nb_frames = 1;
+    m_status = Ready;
+    m_quit = false;
+    m_acq_started = false;
+    m_thread_running = true;
+    m_image_number = 0;
+    m_nb_event_waiters = 0;
+    m_event_fd = -1;
+    m_camera = NULL;
+    m_format7_camera = NULL;
+    m_gige_camera = NULL;
+    m_capture_mode = CaptureRetrieve;
+    m_callback_active = false;
+    m_nb_running_callbacks = 0;
+    memset(&m_grab_stats, 0, sizeof(m_grab_stats));
+    m_grab_start_time = 0.;
+    m_grab_start_cpu_time = 0.;
+    m_preset_switch_time = 0.;
+    m_gpio_metadata_active = false;
+    m_frame_counter_active = false;
+    m_embedded_timestamp_active = false;
+    m_cycle_time_base = 0.;
+    m_last_cycle_time = 0.;
+    m_seq_active = false;
+    m_seq_on_device = false;
+    m_embedded_settings_active = false;
+    m_seq_counter_started = false;
+    m_seq_counter_origin = 0;
+    m_correction_active = false;
+    m_accumulation_active = false;
+    m_beam_active = false;
+    m_roi_counters_active = false;
+    m_selection_active = false;
+    m_event_active = false;
+    m_event_nb_post_frames = 0;
+    m_event_gpio_pin = -1;
+    m_event_gpio_edge = EventRisingEdge;
+    m_event_gpio_level = -1;
+    m_event_post_left = 0;
+    m_event_pending = false;
+    memset(&m_event_stats, 0, sizeof(m_event_stats));
+    m_raw_frame_nb = 0;
+    m_frame_publish_active = true;
+    m_defect_active = false;
+    m_compression_active = false;
+    m_recorder_active = false;
+    m_shm_active = false;
+    m_replay_active = false;
+    m_acq_thread = NULL;
+}
+
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
@@ -89,8 +243,13 @@ Camera::~Camera()
 {
     DEB_DESTRUCTOR();
     delete m_acq_thread;
-    m_camera->Disconnect();
-    delete m_camera;
+    if (m_camera)
+    {
+        m_camera->Disconnect();
+        delete m_camera;
+    }
+    if (m_event_fd >= 0)
+        close(m_event_fd);
 }
 
 //-----------------------------------------------------
@@ -99,17 +258,33 @@ Camera::~Camera()
 void Camera::_getImageSettingsInfo()
 {
     DEB_MEMBER_FUNCT();
-#ifdef USE_GIGE
-    m_error = m_camera->GetGigEImageSettingsInfo(&m_image_settings_info);
-#else
+    if (!m_camera)
+        return;
+    if (m_gige_camera)
+    {
+        FlyCapture2::GigEImageSettingsInfo info;
+        m_error = m_gige_camera->GetGigEImageSettingsInfo(&info);
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Failed to get GigE image settings info: " << m_error.GetDescription();
+        m_image_settings_info.mode = FlyCapture2::MODE_0;
+        m_image_settings_info.maxWidth = info.maxWidth;
+        m_image_settings_info.maxHeight = info.maxHeight;
+        m_image_settings_info.offsetHStepSize = info.offsetHStepSize;
+        m_image_settings_info.offsetVStepSize = info.offsetVStepSize;
+        m_image_settings_info.imageHStepSize = info.imageHStepSize;
+        m_image_settings_info.imageVStepSize = info.imageVStepSize;
+        m_image_settings_info.pixelFormatBitField = info.pixelFormatBitField;
+        m_image_settings_info.vendorPixelFormatBitField = info.vendorPixelFormatBitField;
+        return;
+    }
+
     bool fmt7_supported;
     m_image_settings_info.mode = FlyCapture2::MODE_0;
-    m_error = m_camera->GetFormat7Info(&m_image_settings_info, &fmt7_supported);
-    if (!fmt7_supported)
-        THROW_HW_ERROR(Error) << "Format7 is not supported";
-#endif
+    m_error = m_format7_camera->GetFormat7Info(&m_image_settings_info, &fmt7_supported);
     if (m_error != FlyCapture2::PGRERROR_OK)
         THROW_HW_ERROR(Error) << "Failed to get Format7 info: " << m_error.GetDescription();
+    if (!fmt7_supported)
+        THROW_HW_ERROR(Error) << "Format7 is not supported";
 }
 
 //-----------------------------------------------------
@@ -118,21 +293,33 @@ void Camera::_getImageSettingsInfo()
 void Camera::_applyImageSettings()
 {
     DEB_MEMBER_FUNCT();
-#ifdef USE_GIGE
-    m_error = m_camera->SetGigEImageSettings(&m_image_settings);
-#else
-    bool valid;
-    FlyCapture2::Format7PacketInfo packet_info;
-    m_error = m_camera->ValidateFormat7Settings(&m_image_settings, &valid, &packet_info);
+    if (!m_camera)
+        // replayed frames keep the recorded format, checked in prepareAcq
+        return;
+    if (m_gige_camera)
+    {
+        FlyCapture2::GigEImageSettings settings;
+        settings.offsetX = m_image_settings.offsetX;
+        settings.offsetY = m_image_settings.offsetY;
+        settings.width = m_image_settings.width;
+        settings.height = m_image_settings.height;
+        settings.pixelFormat = m_image_settings.pixelFormat;
+        m_error = m_gige_camera->SetGigEImageSettings(&settings);
+    }
+    else
+    {
+        bool valid;
+        FlyCapture2::Format7PacketInfo packet_info;
+        m_error = m_format7_camera->ValidateFormat7Settings(&m_image_settings, &valid, &packet_info);
 
-    if (m_error != FlyCapture2::PGRERROR_OK)
-        THROW_HW_ERROR(Error) << "Unable to validate image format settings: " << m_error.GetDescription();
-    if (!valid)
-        THROW_HW_ERROR(Error) << "Unsupported image format settings";
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Unable to validate image format settings: " << m_error.GetDescription();
+        if (!valid)
+            THROW_HW_ERROR(Error) << "Unsupported image format settings";
 
-    m_error = m_camera->SetFormat7Configuration(&m_image_settings,
-                                                packet_info.recommendedBytesPerPacket);
-#endif
+        m_error = m_format7_camera->SetFormat7Configuration(&m_image_settings,
+                                                            packet_info.recommendedBytesPerPacket);
+    }
     if (m_error != FlyCapture2::PGRERROR_OK)
         THROW_HW_ERROR(Error) << "Unable to apply image format settings: " << m_error.GetDescription();
 
@@ -141,23 +328,51 @@ void Camera::_applyImageSettings()
         _forcePGRY16Mode();
 }
 
+//-----------------------------------------------------
+// refresh the image settings after the camera changed them
+//-----------------------------------------------------
+void Camera::_readImageSettings()
+{
+    DEB_MEMBER_FUNCT();
+    if (!m_camera)
+        return;
+    if (m_gige_camera)
+    {
+        FlyCapture2::GigEImageSettings settings;
+        m_error = m_gige_camera->GetGigEImageSettings(&settings);
+        m_image_settings.offsetX = settings.offsetX;
+        m_image_settings.offsetY = settings.offsetY;
+        m_image_settings.width = settings.width;
+        m_image_settings.height = settings.height;
+        m_image_settings.pixelFormat = settings.pixelFormat;
+    }
+    else
+    {
+        unsigned int packet_size;
+        float percentage;
+        m_error = m_format7_camera->GetFormat7Configuration(&m_image_settings, &packet_size, &percentage);
+    }
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to get image format settings: " << m_error.GetDescription();
+}
+
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
 void Camera::getPacketSize(int& packet_size)
 {
     DEB_MEMBER_FUNCT();
-#ifdef USE_GIGE
+    if (!m_gige_camera)
+        THROW_HW_ERROR(NotSupported) << "Packet settings are only available on GigE cameras";
     FlyCapture2::GigEProperty property;
     property.propType = FlyCapture2::PACKET_SIZE;
 
-    m_error = m_camera->GetGigEProperty(&property);
+    m_error = m_gige_camera->GetGigEProperty(&property);
     if (m_error != FlyCapture2::PGRERROR_OK)
         THROW_HW_ERROR(Error) << "Failed to get PACKET_SIZE property: " << m_error.GetDescription();
 
     packet_size = property.value;
     DEB_RETURN() << DEB_VAR1(packet_size);
-#endif
 }
 
 //-----------------------------------------------------
@@ -167,15 +382,15 @@ void Camera::setPacketSize(int packet_size)
 {
     DEB_MEMBER_FUNCT();
     DEB_PARAM() << DEB_VAR1(packet_size);
-#ifdef USE_GIGE
+    if (!m_gige_camera)
+        THROW_HW_ERROR(NotSupported) << "Packet settings are only available on GigE cameras";
     FlyCapture2::GigEProperty property;
     property.propType = FlyCapture2::PACKET_SIZE;
     property.value = packet_size;
 
-    m_error = m_camera->SetGigEProperty(&property);
+    m_error = m_gige_camera->SetGigEProperty(&property);
     if (m_error != FlyCapture2::PGRERROR_OK)
         THROW_HW_ERROR(Error) << "Failed to set PACKET_SIZE property: " << m_error.GetDescription();
-#endif
 }
 
 //-----------------------------------------------------
@@ -184,17 +399,17 @@ void Camera::setPacketSize(int packet_size)
 void Camera::getPacketDelay(int& packet_delay)
 {
     DEB_MEMBER_FUNCT();
-#ifdef USE_GIGE
+    if (!m_gige_camera)
+        THROW_HW_ERROR(NotSupported) << "Packet settings are only available on GigE cameras";
     FlyCapture2::GigEProperty property;
     property.propType = FlyCapture2::PACKET_DELAY;
 
-    m_error = m_camera->GetGigEProperty(&property);
+    m_error = m_gige_camera->GetGigEProperty(&property);
     if (m_error != FlyCapture2::PGRERROR_OK)
         THROW_HW_ERROR(Error) << "Failed to get PACKET_DELAY property: " << m_error.GetDescription();
 
     packet_delay = property.value;
     DEB_RETURN() << DEB_VAR1(packet_delay);
-#endif
 }
 
 //-----------------------------------------------------
@@ -204,15 +419,15 @@ void Camera::setPacketDelay(int packet_delay)
 {
     DEB_MEMBER_FUNCT();
     DEB_PARAM() << DEB_VAR1(packet_delay);
-#ifdef USE_GIGE
+    if (!m_gige_camera)
+        THROW_HW_ERROR(NotSupported) << "Packet settings are only available on GigE cameras";
     FlyCapture2::GigEProperty property;
     property.propType = FlyCapture2::PACKET_DELAY;
     property.value = packet_delay;
 
-    m_error = m_camera->SetGigEProperty(&property);
+    m_error = m_gige_camera->SetGigEProperty(&property);
     if (m_error != FlyCapture2::PGRERROR_OK)
         THROW_HW_ERROR(Error) << "Failed to set PACKET_DELAY property: " << m_error.GetDescription();
-#endif
 }
 
 //-----------------------------------------------------
@@ -221,7 +436,94 @@ void Camera::setPacketDelay(int packet_delay)
 void Camera::prepareAcq()
 {
     DEB_MEMBER_FUNCT();
+    POINTGREY_TRACE(m_tracer, "prepareAcq", 0);
     m_image_number = 0;
+    m_raw_frame_nb = 0;
+    memset(&m_grab_stats, 0, sizeof(m_grab_stats));
+
+    if (m_capture_mode == CaptureCallback && m_replay_active)
+        THROW_HW_ERROR(Error) << "Callback capture mode is not available in replay";
+
+    m_buffer_ctrl_obj.getAllocMgr().prefault();
+
+    int nb_buffers;
+    m_buffer_ctrl_obj.getBuffer().getNbBuffers(nb_buffers);
+    m_frame_metadata.resize(nb_buffers);
+
+    Size frame_size(m_image_settings.width, m_image_settings.height);
+    if (m_replay_active)
+    {
+        if (!m_replay.isOpen())
+            THROW_HW_ERROR(Error) << "No replay file";
+        ImageType sensor_type;
+        _getSensorImageType(sensor_type);
+        if (m_replay.getFrameDim() != FrameDim(frame_size, sensor_type))
+            THROW_HW_ERROR(Error) << "Replay frames do not match the image settings: "
+                                  << m_replay.getFrameDim();
+    }
+    if (m_correction_active)
+        m_correction.prepare(frame_size);
+    if (m_accumulation_active)
+    {
+        if (m_correction_active || m_recorder_active)
+            THROW_HW_ERROR(Error) << "Accumulation can not be combined with the correction "
+                                  << "or the recorder";
+        // each step applies to a single exposure, the sub-frames of a sum would mix them
+        if (m_seq_active && m_seq_steps.size() > 1)
+            THROW_HW_ERROR(Error) << "Accumulation can not be combined with an exposure/gain sequence";
+        ImageType sensor_type;
+        _getSensorImageType(sensor_type);
+        m_accumulator.prepare(frame_size, sensor_type);
+    }
+    if (m_selection_active && m_event_active)
+        THROW_HW_ERROR(Error) << "Frame selection and event history are exclusive";
+    if (m_event_active && m_event_gpio_pin >= 0 && !m_gpio_metadata_active)
+        THROW_HW_ERROR(Error) << "GPIO events need the GPIO metadata";
+    if (m_beam_active || m_roi_counters_active || m_selection_active || m_event_active)
+    {
+        ImageType type;
+        _getSensorImageType(type);
+        if (m_accumulation_active)
+            type = Bpp32;
+        if (m_beam_active)
+            m_beam_analyzer.prepare(frame_size, type);
+        if (m_roi_counters_active)
+            m_roi_counters.prepare(frame_size, type);
+        if (m_selection_active)
+        {
+            m_frame_selector.prepare(frame_size, type);
+            m_selection_history.setCapacity(m_frame_selector.getNbPreFrames());
+            m_selection_history.prepare(FrameDim(frame_size, type));
+        }
+        if (m_event_active)
+        {
+            // preallocated here, the acquisition thread only copies into it
+            m_event_history.prepare(FrameDim(frame_size, type));
+            m_event_gpio_level = -1;
+            m_event_post_left = 0;
+            m_event_pending = false;
+            memset(&m_event_stats, 0, sizeof(m_event_stats));
+            m_event_stats.last_event_frame_nb = -1;
+            m_published_event_stats.store(m_event_stats);
+        }
+    }
+    // also sized when inactive, for a build started before startAcq()
+    m_defect_map.prepare(frame_size);
+    if (m_compression_active)
+        m_compressor.prepare(m_buffer_ctrl_obj.getBuffer().getFrameDim());
+    if (m_recorder_active)
+    {
+        ImageType sensor_type;
+        _getSensorImageType(sensor_type);
+        m_recorder.open(FrameDim(frame_size, sensor_type));
+    }
+    if (m_shm_active)
+        m_shm_publisher.prepare(m_buffer_ctrl_obj.getBuffer().getFrameDim());
+
+    if (m_camera)
+        _applyEmbeddedImageInfo();
+
+    _prepareExpGainSequence();
 }
 
 //-----------------------------------------------------
@@ -230,15 +532,33 @@ void Camera::prepareAcq()
 void Camera::startAcq()
 {
     DEB_MEMBER_FUNCT();
+    POINTGREY_TRACE(m_tracer, "startAcq", 0);
 
     DEB_TRACE() << "Start acquisition";
 
     StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj.getBuffer();
-    buffer_mgr.setStartTimestamp(Timestamp::now());
+    m_grab_start_time = Timestamp::now();
+    m_grab_start_cpu_time = _getProcessCpuTime();
+    buffer_mgr.setStartTimestamp(m_grab_start_time);
 
-    m_error = m_camera->StartCapture();
-    if (m_error != FlyCapture2::PGRERROR_OK)
-        THROW_HW_ERROR(Error) << "Unable to start image capture: " << m_error.GetDescription();
+    if (m_replay_active)
+        m_replay.start();
+    else if (m_capture_mode == CaptureCallback)
+    {
+        m_callback_active = true;
+        m_error = m_camera->StartCapture(_imageCallback, this);
+        if (m_error != FlyCapture2::PGRERROR_OK)
+        {
+            m_callback_active = false;
+            THROW_HW_ERROR(Error) << "Unable to start image capture: " << m_error.GetDescription();
+        }
+    }
+    else
+    {
+        m_error = m_camera->StartCapture();
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Unable to start image capture: " << m_error.GetDescription();
+    }
 
     // Start acquisition thread
     AutoMutex lock(m_cond.mutex());
@@ -252,16 +572,28 @@ void Camera::startAcq()
 void Camera::stopAcq()
 {
     DEB_MEMBER_FUNCT();
+    POINTGREY_TRACE(m_tracer, "stopAcq", m_image_number);
     AutoMutex lock(m_cond.mutex());
     if (!m_acq_started)
         return;
     m_acq_started = false;
+    m_cond.broadcast();
     lock.unlock();
+    // the frame waiters give up
+    _notifyEvent();
 
     DEB_TRACE() << "Stop acquisition";
-    m_error = m_camera->StopCapture();
-    if (m_error != FlyCapture2::PGRERROR_OK)
-        THROW_HW_ERROR(Error) << "Unable to stop image capture: " << m_error.GetDescription();
+    if (m_replay_active)
+        m_replay.abort();
+    else
+    {
+        m_error = m_camera->StopCapture();
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Unable to stop image capture: " << m_error.GetDescription();
+    }
+
+    if (m_seq_on_device)
+        _disableDeviceSequence();
 
     _setStatus(Camera::Ready, false);
 }
@@ -276,6 +608,24 @@ void Camera::getDetectorImageSize(Size& size)
     DEB_RETURN() << DEB_VAR1(size);
 }
 
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getInterfaceType(string& type)
+{
+    DEB_MEMBER_FUNCT();
+    switch (m_camera_info.interfaceType)
+    {
+    case FlyCapture2::INTERFACE_GIGE:     type = "GigE"; break;
+    case FlyCapture2::INTERFACE_USB3:     type = "USB3"; break;
+    case FlyCapture2::INTERFACE_USB2:     type = "USB2"; break;
+    case FlyCapture2::INTERFACE_IEEE1394: type = "FireWire"; break;
+    default:
+        type = m_camera ? "Unknown" : "Replay";
+    }
+    DEB_RETURN() << DEB_VAR1(type);
+}
+
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
@@ -300,6 +650,21 @@ void Camera::getDetectorModel(string& model)
 //
 //-----------------------------------------------------
 void Camera::getImageType(ImageType& type)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_accumulation_active)
+        type = Bpp32;
+    else if (m_correction_active)
+        type = m_correction.getOutputImageType();
+    else
+        _getSensorImageType(type);
+    DEB_RETURN() << DEB_VAR1(type);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_getSensorImageType(ImageType& type)
 {
     DEB_MEMBER_FUNCT();
     switch (m_image_settings.pixelFormat)
@@ -313,7 +678,6 @@ void Camera::getImageType(ImageType& type)
     default:
         THROW_HW_ERROR(Error) << "Unable to determine the image type";
     }
-    DEB_RETURN() << DEB_VAR1(type);
 }
 
 //-----------------------------------------------------
@@ -322,10 +686,17 @@ void Camera::getImageType(ImageType& type)
 void Camera::setImageType(ImageType type)
 {
     DEB_MEMBER_FUNCT();
+    POINTGREY_TRACE(m_tracer, "setImageType", type);
     DEB_PARAM() << DEB_VAR1(type);
 
     FlyCapture2::PixelFormat old_format, new_format;
-    bool valid;
+
+    if (m_accumulation_active && type == Bpp32)
+        // accumulated frames already have this type
+        return;
+    if (m_correction_active && type == m_correction.getOutputImageType())
+        // corrected frames already have this type
+        return;
 
     old_format = m_image_settings.pixelFormat;
 
@@ -359,6 +730,17 @@ void Camera::setImageType(ImageType type)
         THROW_HW_ERROR(Error) << e.getErrDesc();
     }
 
+    _imageTypeChanged();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_imageTypeChanged()
+{
+    DEB_MEMBER_FUNCT();
+    ImageType type;
+    getImageType(type);
     maxImageSizeChanged(Size(m_image_settings_info.maxWidth, m_image_settings_info.maxHeight), type);
 }
 
@@ -371,6 +753,13 @@ void Camera::getTrigMode(TrigMode& mode)
 
     cout << "getTrigMode" << endl;
 
+    if (!m_camera)
+    {
+        mode = IntTrig;
+        DEB_RETURN() << DEB_VAR1(mode);
+        return;
+    }
+
     // Get current trigger settings
     FlyCapture2::TriggerMode triggerMode;
     m_error = m_camera->GetTriggerMode(&triggerMode);
@@ -388,8 +777,16 @@ void Camera::getTrigMode(TrigMode& mode)
 void Camera::setTrigMode(TrigMode mode)
 {
     DEB_MEMBER_FUNCT();
+    POINTGREY_TRACE(m_tracer, "setTrigMode", mode);
     DEB_PARAM() << DEB_VAR1(mode);
 
+    if (!m_camera)
+    {
+        if (mode != IntTrig)
+            THROW_HW_ERROR(Error) << "Trigger mode " << mode << " is not supported in replay";
+        return;
+    }
+
     // Check for external trigger support
     FlyCapture2::TriggerModeInfo triggerModeInfo;
     m_error = m_camera->GetTriggerModeInfo(&triggerModeInfo);
@@ -453,7 +850,7 @@ void Camera::setNbFrames(int nb_frames)
 void Camera::getNbHwAcquiredFrames(int &nb_acq_frames)
 {
     DEB_MEMBER_FUNCT();
-    nb_acq_frames = m_image_number;
+    nb_acq_frames = m_image_number.load(__ATOMIC_ACQUIRE);
 }
 
 //-----------------------------------------------------
@@ -462,192 +859,468 @@ void Camera::getNbHwAcquiredFrames(int &nb_acq_frames)
 void Camera::getStatus(Camera::Status& status)
 {
     DEB_MEMBER_FUNCT();
-    AutoMutex lock(m_cond.mutex());
-    status = m_status;
+    status = m_status.load(__ATOMIC_ACQUIRE);
     DEB_RETURN() << DEB_VAR1(DEB_HEX(status));
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-HwBufferCtrlObj* Camera::getBufferCtrlObj()
+void Camera::waitForFrame(int acq_frame_nb, double timeout, bool& ready)
 {
-    return &m_buffer_ctrl_obj;
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(acq_frame_nb, timeout);
+    double deadline = Timestamp::now() + timeout;
+
+    // no frame comes once the acquisition is stopped or over
+    AutoMutex lock(m_event_cond.mutex());
+    ++m_nb_event_waiters;
+    while (m_image_number <= acq_frame_nb && m_status != Camera::Fault && m_acq_started)
+    {
+        if (timeout < 0)
+            m_event_cond.wait();
+        else
+        {
+            double now = Timestamp::now();
+            if (now >= deadline)
+                break;
+            m_event_cond.wait(deadline - now);
+        }
+    }
+    --m_nb_event_waiters;
+    ready = (m_image_number > acq_frame_nb);
+    DEB_RETURN() << DEB_VAR1(ready);
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::checkRoi(const Roi& set_roi, Roi& hw_roi)
+void Camera::waitForStatusChange(Camera::Status status, double timeout, Camera::Status& new_status)
 {
     DEB_MEMBER_FUNCT();
-    DEB_PARAM() << DEB_VAR1(set_roi);
-    DEB_RETURN() << DEB_VAR1(hw_roi);
+    DEB_PARAM() << DEB_VAR2(status, timeout);
+    double deadline = Timestamp::now() + timeout;
+
+    AutoMutex lock(m_event_cond.mutex());
+    ++m_nb_event_waiters;
+    while (m_status == status)
+    {
+        if (timeout < 0)
+            m_event_cond.wait();
+        else
+        {
+            double now = Timestamp::now();
+            if (now >= deadline)
+                break;
+            m_event_cond.wait(deadline - now);
+        }
+    }
+    --m_nb_event_waiters;
+    new_status = m_status;
+    DEB_RETURN() << DEB_VAR1(new_status);
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::getRoi(Roi& hw_roi)
+void Camera::getEventFd(int& fd)
 {
     DEB_MEMBER_FUNCT();
-    DEB_RETURN() << DEB_VAR1(hw_roi);
+    AutoMutex lock(m_event_cond.mutex());
+    if (m_event_fd < 0)
+    {
+        m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_event_fd < 0)
+            THROW_HW_ERROR(Error) << "Failed to create eventfd: " << strerror(errno);
+    }
+    fd = m_event_fd;
+    DEB_RETURN() << DEB_VAR1(fd);
 }
 
 //-----------------------------------------------------
-//
+// wake the waiters of a new frame or status, only if there are some
 //-----------------------------------------------------
-void Camera::setRoi(const Roi& ask_roi)
+void Camera::_notifyEvent()
 {
+    // Sequentially consistent with the waiter registration in waitForFrame() and
+    // waitForStatusChange(): either the waiter sees the new frame or status, or
+    // the waiter count is seen here. Nothing is locked when nobody listens.
+    if (!m_nb_event_waiters && m_event_fd < 0)
+        return;
+
     DEB_MEMBER_FUNCT();
-    DEB_PARAM() << DEB_VAR1(ask_roi);
+    AutoMutex lock(m_event_cond.mutex());
+    if (m_nb_event_waiters)
+        m_event_cond.broadcast();
+    // created by getEventFd() under the same lock
+    int event_fd = m_event_fd;
+    if (event_fd >= 0)
+    {
+        uint64_t one = 1;
+        if (write(event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            DEB_ERROR() << "Failed to signal eventfd: " << strerror(errno);
+    }
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::checkBin(Bin &aBin)
+HwBufferCtrlObj* Camera::getBufferCtrlObj()
 {
-    DEB_MEMBER_FUNCT();
-    DEB_RETURN() << DEB_VAR1(aBin);
+    return &m_buffer_ctrl_obj;
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::getBin(Bin &aBin)
+void Camera::getBufferPageMode(BufferPageMode& mode)
 {
     DEB_MEMBER_FUNCT();
-    DEB_RETURN() << DEB_VAR1(aBin);
+    mode = BufferPageMode(m_buffer_ctrl_obj.getAllocMgr().getPageMode());
+    DEB_RETURN() << DEB_VAR1(mode);
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::setBin(const Bin &aBin)
+void Camera::setBufferPageMode(BufferPageMode mode)
 {
     DEB_MEMBER_FUNCT();
-    DEB_RETURN() << DEB_VAR1(aBin);
+    DEB_PARAM() << DEB_VAR1(mode);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    switch (mode)
+    {
+    case BufferNormalPages:
+        m_buffer_ctrl_obj.getAllocMgr().setPageMode(HugePageAllocMgr::NormalPages);
+        break;
+    case BufferTransparentHugePages:
+        m_buffer_ctrl_obj.getAllocMgr().setPageMode(HugePageAllocMgr::TransparentHugePages);
+        break;
+    case BufferHugePages2M:
+        m_buffer_ctrl_obj.getAllocMgr().setPageMode(HugePageAllocMgr::HugePages2M);
+        break;
+    case BufferHugePages1G:
+        m_buffer_ctrl_obj.getAllocMgr().setPageMode(HugePageAllocMgr::HugePages1G);
+        break;
+    default:
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(mode);
+    }
 }
 
 //-----------------------------------------------------
-// exposure
+//
 //-----------------------------------------------------
-void Camera::getExpTime(double& exp_time)
+void Camera::getBufferLock(bool& lock)
 {
     DEB_MEMBER_FUNCT();
-    _getPropertyValue(FlyCapture2::SHUTTER, exp_time);
-    DEB_RETURN() << DEB_VAR1(exp_time);
+    lock = m_buffer_ctrl_obj.getAllocMgr().getLock();
+    DEB_RETURN() << DEB_VAR1(lock);
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::setExpTime(double exp_time)
+void Camera::setBufferLock(bool lock)
 {
     DEB_MEMBER_FUNCT();
-    DEB_PARAM() << DEB_VAR1(exp_time);
-    _setPropertyValue(FlyCapture2::SHUTTER, exp_time);
+    DEB_PARAM() << DEB_VAR1(lock);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_buffer_ctrl_obj.getAllocMgr().setLock(lock);
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::getExpTimeRange(double& min_exp_time, double& max_exp_time)
+void Camera::getBufferAllocInfo(HugePageAllocMgr::Info& info)
 {
     DEB_MEMBER_FUNCT();
-    _getPropertyRange(FlyCapture2::SHUTTER, min_exp_time, max_exp_time);
-    DEB_RETURN() << DEB_VAR2(min_exp_time, max_exp_time);
+    m_buffer_ctrl_obj.getAllocMgr().getInfo(info);
 }
 
 //-----------------------------------------------------
-//
+// frame buffer views
 //-----------------------------------------------------
-void Camera::getAutoExpTime(bool &auto_exp_time)
+void Camera::pinFrame(int acq_frame_nb, void *& data, FrameDim& frame_dim)
 {
     DEB_MEMBER_FUNCT();
-    _getPropertyAutoMode(FlyCapture2::SHUTTER, auto_exp_time);
-    DEB_RETURN() << DEB_VAR1(auto_exp_time);
+    DEB_PARAM() << DEB_VAR1(acq_frame_nb);
+    if (!_tryPinFrame(acq_frame_nb, data, frame_dim))
+        THROW_HW_ERROR(InvalidValue) << "Frame not in the buffer ring: " << DEB_VAR1(acq_frame_nb);
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::setAutoExpTime(bool auto_exp_time)
+void Camera::pinLastFrame(int& acq_frame_nb, void *& data, FrameDim& frame_dim)
 {
     DEB_MEMBER_FUNCT();
-    _setPropertyAutoMode(FlyCapture2::SHUTTER, auto_exp_time);
-    DEB_RETURN() << DEB_VAR1(auto_exp_time);
+    // only fails if the ring wrapped between the two reads, retry on the newer frame
+    do
+    {
+        acq_frame_nb = m_image_number - 1;
+        if (acq_frame_nb < 0)
+            THROW_HW_ERROR(Error) << "No frame acquired";
+    }
+    while (!_tryPinFrame(acq_frame_nb, data, frame_dim));
+    DEB_RETURN() << DEB_VAR1(acq_frame_nb);
 }
 
 //-----------------------------------------------------
-// gain
+//
 //-----------------------------------------------------
-void Camera::getGain(double& gain)
+void Camera::unpinFrame(int acq_frame_nb)
 {
     DEB_MEMBER_FUNCT();
-    _getPropertyValue(FlyCapture2::GAIN, gain);
-    DEB_RETURN() << DEB_VAR1(gain);
+    DEB_PARAM() << DEB_VAR1(acq_frame_nb);
+    HugePageAllocMgr& alloc_mgr = m_buffer_ctrl_obj.getAllocMgr();
+    int nb_buffers;
+    alloc_mgr.getNbBuffers(nb_buffers);
+    if (acq_frame_nb < 0 || !nb_buffers)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(acq_frame_nb);
+    alloc_mgr.unpinBuffer(acq_frame_nb % nb_buffers);
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::setGain(double gain)
+void Camera::getNbPinnedFrames(int& nb_frames)
 {
     DEB_MEMBER_FUNCT();
-    DEB_PARAM() << DEB_VAR1(gain);
-    _setPropertyValue(FlyCapture2::GAIN, gain);
+    nb_frames = m_buffer_ctrl_obj.getAllocMgr().getNbPins();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
 }
 
 //-----------------------------------------------------
-//
+// pin the buffer, then check the frame is still in it
 //-----------------------------------------------------
-void Camera::getGainRange(double& min_gain, double& max_gain)
+bool Camera::_tryPinFrame(int acq_frame_nb, void *& data, FrameDim& frame_dim)
 {
     DEB_MEMBER_FUNCT();
-    _getPropertyRange(FlyCapture2::GAIN, min_gain, max_gain);
-    DEB_RETURN() << DEB_VAR2(min_gain, max_gain);
+    if (m_recorder_active)
+        THROW_HW_ERROR(Error) << "Frames are not published while recording";
+
+    HugePageAllocMgr& alloc_mgr = m_buffer_ctrl_obj.getAllocMgr();
+    int nb_buffers;
+    alloc_mgr.getNbBuffers(nb_buffers);
+    if (nb_buffers < 2)
+        THROW_HW_ERROR(Error) << "At least 2 frame buffers are needed to view frames";
+    if (acq_frame_nb < 0)
+        return false;
+
+    int buffer_nb = acq_frame_nb % nb_buffers;
+    alloc_mgr.pinBuffer(buffer_nb);
+
+    // Sequentially consistent with _waitFrameUnpinned(): either the acquisition
+    // thread sees the pin, or the frame counter read here is up to date. The
+    // oldest frame of the ring may be being overwritten and is not pinnable.
+    int image_number = m_image_number;
+    if (acq_frame_nb >= image_number || acq_frame_nb <= image_number - nb_buffers)
+    {
+        alloc_mgr.unpinBuffer(buffer_nb);
+        return false;
+    }
+    data = alloc_mgr.getBufferPtr(buffer_nb);
+    frame_dim = alloc_mgr.getFrameDim();
+    return true;
 }
 
 //-----------------------------------------------------
-//
+// called before overwriting a buffer, false if the acquisition was stopped
 //-----------------------------------------------------
-void Camera::getAutoGain(bool& auto_gain)
+bool Camera::_waitFrameUnpinned()
 {
     DEB_MEMBER_FUNCT();
-    _getPropertyAutoMode(FlyCapture2::GAIN, auto_gain);
-    DEB_RETURN() << DEB_VAR1(auto_gain);
+    HugePageAllocMgr& alloc_mgr = m_buffer_ctrl_obj.getAllocMgr();
+    if (!alloc_mgr.getNbPins())
+        return true;
+
+    int nb_buffers;
+    alloc_mgr.getNbBuffers(nb_buffers);
+    int buffer_nb = m_image_number % nb_buffers;
+    while (!alloc_mgr.waitUnpinned(buffer_nb, 0.1))
+    {
+        DEB_TRACE() << "Waiting for frame buffer " << buffer_nb << " to be unpinned";
+        if (!m_acq_started)
+            return false;
+    }
+    return true;
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::setAutoGain(bool auto_gain)
+void Camera::checkRoi(const Roi& set_roi, Roi& hw_roi)
 {
     DEB_MEMBER_FUNCT();
-    DEB_PARAM() << DEB_VAR1(auto_gain);
-    _setPropertyAutoMode(FlyCapture2::GAIN, auto_gain);
+    DEB_PARAM() << DEB_VAR1(set_roi);
+    DEB_RETURN() << DEB_VAR1(hw_roi);
 }
 
 //-----------------------------------------------------
-// frame rate
+//
 //-----------------------------------------------------
-void Camera::getFrameRate(double& frame_rate)
+void Camera::getRoi(Roi& hw_roi)
 {
     DEB_MEMBER_FUNCT();
-    _getPropertyValue(FlyCapture2::FRAME_RATE, frame_rate);
-    DEB_RETURN() << DEB_VAR1(frame_rate);
+    DEB_RETURN() << DEB_VAR1(hw_roi);
 }
 
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::setFrameRate(double frame_rate)
+void Camera::setRoi(const Roi& ask_roi)
 {
     DEB_MEMBER_FUNCT();
-    DEB_PARAM() << DEB_VAR1(frame_rate);
-    _setPropertyValue(FlyCapture2::FRAME_RATE, frame_rate);
+    DEB_PARAM() << DEB_VAR1(ask_roi);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::checkBin(Bin &aBin)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_RETURN() << DEB_VAR1(aBin);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getBin(Bin &aBin)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_RETURN() << DEB_VAR1(aBin);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setBin(const Bin &aBin)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_RETURN() << DEB_VAR1(aBin);
+}
+
+//-----------------------------------------------------
+// exposure
+//-----------------------------------------------------
+void Camera::getExpTime(double& exp_time)
+{
+    DEB_MEMBER_FUNCT();
+    _getPropertyValue(FlyCapture2::SHUTTER, exp_time);
+    DEB_RETURN() << DEB_VAR1(exp_time);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setExpTime(double exp_time)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(exp_time);
+    _setPropertyValue(FlyCapture2::SHUTTER, exp_time);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getExpTimeRange(double& min_exp_time, double& max_exp_time)
+{
+    DEB_MEMBER_FUNCT();
+    _getPropertyRange(FlyCapture2::SHUTTER, min_exp_time, max_exp_time);
+    DEB_RETURN() << DEB_VAR2(min_exp_time, max_exp_time);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getAutoExpTime(bool &auto_exp_time)
+{
+    DEB_MEMBER_FUNCT();
+    _getPropertyAutoMode(FlyCapture2::SHUTTER, auto_exp_time);
+    DEB_RETURN() << DEB_VAR1(auto_exp_time);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAutoExpTime(bool auto_exp_time)
+{
+    DEB_MEMBER_FUNCT();
+    _setPropertyAutoMode(FlyCapture2::SHUTTER, auto_exp_time);
+    DEB_RETURN() << DEB_VAR1(auto_exp_time);
+}
+
+//-----------------------------------------------------
+// gain
+//-----------------------------------------------------
+void Camera::getGain(double& gain)
+{
+    DEB_MEMBER_FUNCT();
+    _getPropertyValue(FlyCapture2::GAIN, gain);
+    DEB_RETURN() << DEB_VAR1(gain);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setGain(double gain)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(gain);
+    _setPropertyValue(FlyCapture2::GAIN, gain);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getGainRange(double& min_gain, double& max_gain)
+{
+    DEB_MEMBER_FUNCT();
+    _getPropertyRange(FlyCapture2::GAIN, min_gain, max_gain);
+    DEB_RETURN() << DEB_VAR2(min_gain, max_gain);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getAutoGain(bool& auto_gain)
+{
+    DEB_MEMBER_FUNCT();
+    _getPropertyAutoMode(FlyCapture2::GAIN, auto_gain);
+    DEB_RETURN() << DEB_VAR1(auto_gain);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAutoGain(bool auto_gain)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(auto_gain);
+    _setPropertyAutoMode(FlyCapture2::GAIN, auto_gain);
+}
+
+//-----------------------------------------------------
+// frame rate
+//-----------------------------------------------------
+void Camera::getFrameRate(double& frame_rate)
+{
+    DEB_MEMBER_FUNCT();
+    _getPropertyValue(FlyCapture2::FRAME_RATE, frame_rate);
+    DEB_RETURN() << DEB_VAR1(frame_rate);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setFrameRate(double frame_rate)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(frame_rate);
+    _setPropertyValue(FlyCapture2::FRAME_RATE, frame_rate);
 }
 
 //-----------------------------------------------------
@@ -681,11 +1354,2560 @@ void Camera::setAutoFrameRate(bool auto_frame_rate)
 }
 
 //-----------------------------------------------------
-// property management
+// driver image queue
 //-----------------------------------------------------
-void Camera::_getPropertyValue(FlyCapture2::PropertyType type, double& value)
+void Camera::getDriverNbBuffers(int& nb_buffers)
+{
+    DEB_MEMBER_FUNCT();
+    nb_buffers = m_config.numBuffers;
+    DEB_RETURN() << DEB_VAR1(nb_buffers);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setDriverNbBuffers(int nb_buffers)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_buffers);
+    if (nb_buffers < 1)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_buffers);
+
+    FlyCapture2::FC2Config config = m_config;
+    config.numBuffers = nb_buffers;
+    _applyConfiguration(config);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getDriverGrabMode(DriverGrabMode& mode)
+{
+    DEB_MEMBER_FUNCT();
+    mode = (m_config.grabMode == FlyCapture2::BUFFER_FRAMES) ? DriverBufferFrames : DriverDropFrames;
+    DEB_RETURN() << DEB_VAR1(mode);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setDriverGrabMode(DriverGrabMode mode)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(mode);
+
+    FlyCapture2::FC2Config config = m_config;
+    switch (mode)
+    {
+    case DriverDropFrames:
+        config.grabMode = FlyCapture2::DROP_FRAMES;
+        break;
+    case DriverBufferFrames:
+        config.grabMode = FlyCapture2::BUFFER_FRAMES;
+        break;
+    default:
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(mode);
+    }
+    _applyConfiguration(config);
+}
+
+//-----------------------------------------------------
+// timeout in ms, -1 for no timeout
+//-----------------------------------------------------
+void Camera::getDriverGrabTimeout(int& timeout)
+{
+    DEB_MEMBER_FUNCT();
+    timeout = (m_config.grabTimeout < 0) ? -1 : m_config.grabTimeout;
+    DEB_RETURN() << DEB_VAR1(timeout);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setDriverGrabTimeout(int timeout)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(timeout);
+
+    FlyCapture2::FC2Config config = m_config;
+    config.grabTimeout = (timeout < 0) ? int(FlyCapture2::TIMEOUT_INFINITE) : timeout;
+    _applyConfiguration(config);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getDriverHighPerformanceRetrieve(bool& high_performance)
+{
+    DEB_MEMBER_FUNCT();
+    high_performance = m_config.highPerformanceRetrieveBuffer;
+    DEB_RETURN() << DEB_VAR1(high_performance);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setDriverHighPerformanceRetrieve(bool high_performance)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(high_performance);
+
+    FlyCapture2::FC2Config config = m_config;
+    config.highPerformanceRetrieveBuffer = high_performance;
+    _applyConfiguration(config);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_applyConfiguration(const FlyCapture2::FC2Config& config)
+{
+    DEB_MEMBER_FUNCT();
+    // the driver queue is allocated by StartCapture
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+
+    if (m_camera)
+    {
+        m_error = m_camera->SetConfiguration(&config);
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Failed to set camera configuration: " << m_error.GetDescription();
+    }
+    m_config = config;
+}
+
+//-----------------------------------------------------
+// capture mode
+//-----------------------------------------------------
+void Camera::getCaptureMode(CaptureMode& mode)
+{
+    DEB_MEMBER_FUNCT();
+    mode = m_capture_mode;
+    DEB_RETURN() << DEB_VAR1(mode);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setCaptureMode(CaptureMode mode)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(mode);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    if (mode == CaptureCallback && !m_camera)
+        THROW_HW_ERROR(NotSupported) << "No camera connected";
+    m_capture_mode = mode;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getGrabStats(GrabStats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    stats = m_grab_stats;
+    DEB_RETURN() << DEB_VAR4(stats.nb_frames, stats.mean_latency, stats.max_latency, stats.cpu_load);
+}
+
+//-----------------------------------------------------
+// the clock model is frozen after the warm-up so that both modes are
+// measured against the same camera to host line
+//-----------------------------------------------------
+void Camera::runGrabBenchmark(int nb_frames, GrabStats& retrieve_stats, GrabStats& callback_stats)
 {
     DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (nb_frames < 1)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_frames);
+    if (!m_camera || m_replay_active)
+        THROW_HW_ERROR(NotSupported) << "Benchmark needs a live camera";
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    int nb_buffers;
+    m_buffer_ctrl_obj.getBuffer().getNbBuffers(nb_buffers);
+    if (!nb_buffers)
+        THROW_HW_ERROR(Error) << "Frame buffers are not allocated";
+
+    CaptureMode capture_mode = m_capture_mode;
+    int acq_nb_frames = m_nb_frames;
+    try
+    {
+        GrabStats warm_up;
+        _runBenchmarkAcq(CaptureRetrieve, nb_frames, warm_up);
+
+        ClockModel::Stats clock_stats;
+        m_clock_model.getStats(clock_stats);
+        if (!clock_stats.nb_samples)
+            THROW_HW_ERROR(Error) << "No camera timestamps to measure the latency";
+
+        m_clock_model.setFrozen(true);
+        _runBenchmarkAcq(CaptureRetrieve, nb_frames, retrieve_stats);
+        _runBenchmarkAcq(CaptureCallback, nb_frames, callback_stats);
+    }
+    catch (...)
+    {
+        m_clock_model.setFrozen(false);
+        m_capture_mode = capture_mode;
+        m_nb_frames = acq_nb_frames;
+        throw;
+    }
+    m_clock_model.setFrozen(false);
+    m_capture_mode = capture_mode;
+    m_nb_frames = acq_nb_frames;
+}
+
+//-----------------------------------------------------
+// one blocking acquisition of nb_frames
+//-----------------------------------------------------
+void Camera::_runBenchmarkAcq(CaptureMode mode, int nb_frames, GrabStats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(mode, nb_frames);
+    m_capture_mode = mode;
+    m_nb_frames = nb_frames;
+
+    double frame_rate;
+    getFrameRate(frame_rate);
+    double timeout = 5. + 2. * nb_frames / ((frame_rate > 1.) ? frame_rate : 1.);
+
+    prepareAcq();
+    startAcq();
+
+    bool timed_out = false;
+    double deadline = Timestamp::now() + timeout;
+    AutoMutex lock(m_cond.mutex());
+    while (m_acq_started || m_thread_running)
+    {
+        double now = Timestamp::now();
+        if (now >= deadline)
+        {
+            timed_out = true;
+            break;
+        }
+        m_cond.wait(deadline - now);
+    }
+    lock.unlock();
+
+    if (timed_out)
+    {
+        stopAcq();
+        THROW_HW_ERROR(Error) << "Benchmark acquisition timed out";
+    }
+    if (m_status == Camera::Fault)
+        THROW_HW_ERROR(Error) << "Benchmark acquisition failed";
+    getGrabStats(stats);
+}
+
+//-----------------------------------------------------
+// presets
+//-----------------------------------------------------
+void Camera::getNbMemoryChannels(int& nb_channels)
+{
+    DEB_MEMBER_FUNCT();
+    unsigned int nb = 0;
+    if (m_camera)
+    {
+        m_error = m_camera->GetMemoryChannelInfo(&nb);
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Failed to get memory channel info: " << m_error.GetDescription();
+    }
+    nb_channels = nb;
+    DEB_RETURN() << DEB_VAR1(nb_channels);
+}
+
+//-----------------------------------------------------
+// snapshot the configuration, and store the camera one in a memory channel
+//-----------------------------------------------------
+void Camera::savePreset(const std::string& name, int channel)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(name, channel);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+
+    if (channel)
+    {
+        int nb_channels;
+        getNbMemoryChannels(nb_channels);
+        if (channel < 1 || channel > nb_channels)
+            THROW_HW_ERROR(InvalidValue) << "Invalid memory " << DEB_VAR1(channel)
+                                         << ", the camera has " << nb_channels;
+    }
+
+    _Preset preset;
+    preset.channel = channel;
+    preset.image_settings = m_image_settings;
+    preset.config = m_config;
+    getTrigMode(preset.trig_mode);
+    _getPropertyValue(FlyCapture2::SHUTTER, preset.exp_time);
+    _getPropertyValue(FlyCapture2::GAIN, preset.gain);
+    _getPropertyValue(FlyCapture2::FRAME_RATE, preset.frame_rate);
+    _getPropertyAutoMode(FlyCapture2::SHUTTER, preset.auto_exp_time);
+    _getPropertyAutoMode(FlyCapture2::GAIN, preset.auto_gain);
+    _getPropertyAutoMode(FlyCapture2::FRAME_RATE, preset.auto_frame_rate);
+    preset.seq_active = m_seq_active;
+    preset.correction_active = m_correction_active;
+    preset.correction_type = m_correction.getOutputImageType();
+    preset.defect_active = m_defect_active;
+    getDefectCorrectionMode(preset.defect_mode);
+    preset.compression_active = m_compression_active;
+
+    if (channel)
+    {
+        m_error = m_camera->SaveToMemoryChannel(channel);
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Failed to save memory channel: " << m_error.GetDescription();
+    }
+    m_presets[name] = preset;
+}
+
+//-----------------------------------------------------
+// a single memory channel restore when the preset has one, unless host_only
+// asks for the write-by-write path
+//-----------------------------------------------------
+void Camera::recallPreset(const std::string& name, bool host_only)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(name, host_only);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+
+    std::map<std::string, _Preset>::const_iterator it = m_presets.find(name);
+    if (it == m_presets.end())
+        THROW_HW_ERROR(InvalidValue) << "No preset named " << name;
+    const _Preset& preset = it->second;
+
+    double start = Timestamp::now();
+    if (preset.channel && !host_only && m_camera)
+    {
+        m_error = m_camera->RestoreFromMemoryChannel(preset.channel);
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Failed to restore memory channel: " << m_error.GetDescription();
+        _readImageSettings();
+        if (m_image_settings.pixelFormat == FlyCapture2::PIXEL_FORMAT_MONO16)
+            _forcePGRY16Mode();
+    }
+    else
+    {
+        m_image_settings = preset.image_settings;
+        _applyImageSettings();
+        setTrigMode(preset.trig_mode);
+        _restoreProperty(FlyCapture2::SHUTTER, preset.exp_time, preset.auto_exp_time);
+        _restoreProperty(FlyCapture2::GAIN, preset.gain, preset.auto_gain);
+        _restoreProperty(FlyCapture2::FRAME_RATE, preset.frame_rate, preset.auto_frame_rate);
+    }
+
+    // the driver configuration is host side, only apply it when it changed
+    if (preset.config.numBuffers != m_config.numBuffers ||
+        preset.config.grabMode != m_config.grabMode ||
+        preset.config.grabTimeout != m_config.grabTimeout ||
+        preset.config.highPerformanceRetrieveBuffer != m_config.highPerformanceRetrieveBuffer)
+        _applyConfiguration(preset.config);
+
+    m_seq_active = preset.seq_active;
+    m_correction_active = preset.correction_active;
+    m_correction.setOutputImageType(preset.correction_type);
+    m_defect_active = preset.defect_active;
+    setDefectCorrectionMode(preset.defect_mode);
+    m_compression_active = preset.compression_active;
+    m_preset_switch_time = Timestamp::now() - start;
+
+    DEB_TRACE() << "Preset " << name << " recalled in " << m_preset_switch_time * 1E3 << " ms"
+                << ((preset.channel && !host_only && m_camera) ? " from memory channel" : "");
+    _imageTypeChanged();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::removePreset(const std::string& name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(name);
+    if (!m_presets.erase(name))
+        THROW_HW_ERROR(InvalidValue) << "No preset named " << name;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getNbPresets(int& nb_presets)
+{
+    DEB_MEMBER_FUNCT();
+    nb_presets = m_presets.size();
+    DEB_RETURN() << DEB_VAR1(nb_presets);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getPresetName(int index, std::string& name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(index);
+    if (index < 0 || index >= int(m_presets.size()))
+        THROW_HW_ERROR(InvalidValue) << "Invalid preset " << DEB_VAR1(index);
+    std::map<std::string, _Preset>::const_iterator it = m_presets.begin();
+    std::advance(it, index);
+    name = it->first;
+    DEB_RETURN() << DEB_VAR1(name);
+}
+
+//-----------------------------------------------------
+// duration of the last recallPreset(), in s
+//-----------------------------------------------------
+void Camera::getPresetSwitchTime(double& switch_time)
+{
+    DEB_MEMBER_FUNCT();
+    switch_time = m_preset_switch_time;
+    DEB_RETURN() << DEB_VAR1(switch_time);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_restoreProperty(FlyCapture2::PropertyType type, double value, bool auto_mode)
+{
+    DEB_MEMBER_FUNCT();
+    if (auto_mode)
+        _setPropertyAutoMode(type, true);
+    else
+        _setPropertyValue(type, value);
+}
+
+//-----------------------------------------------------
+// strobe and GPIO
+//-----------------------------------------------------
+void Camera::getNbGpioPins(int& nb_pins)
+{
+    DEB_MEMBER_FUNCT();
+    nb_pins = m_camera ? k_NbGpioPins : 0;
+    DEB_RETURN() << DEB_VAR1(nb_pins);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getStrobe(int pin, StrobeMode& mode, StrobePolarity& polarity,
+                       double& delay, double& duration)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(pin);
+    _checkGpioPin(pin);
+
+    FlyCapture2::StrobeControl strobe;
+    strobe.source = pin;
+    m_error = m_camera->GetStrobe(&strobe);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to get strobe: " << m_error.GetDescription();
+
+    if (!strobe.onOff)
+        mode = StrobeOff;
+    else
+        mode = (strobe.duration > 0) ? StrobeFixedDuration : StrobeExposureActive;
+    polarity = strobe.polarity ? StrobeActiveHigh : StrobeActiveLow;
+    delay = strobe.delay;
+    duration = strobe.duration;
+    DEB_RETURN() << DEB_VAR4(mode, polarity, delay, duration);
+}
+
+//-----------------------------------------------------
+// the strobe starts delay ms after exposure start and lasts either the
+// exposure (StrobeExposureActive) or duration ms (StrobeFixedDuration)
+//-----------------------------------------------------
+void Camera::setStrobe(int pin, StrobeMode mode, StrobePolarity polarity,
+                       double delay, double duration)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR5(pin, mode, polarity, delay, duration);
+    _checkGpioPin(pin);
+
+    FlyCapture2::StrobeInfo info;
+    info.source = pin;
+    m_error = m_camera->GetStrobeInfo(&info);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to get strobe info: " << m_error.GetDescription();
+    if (!info.present)
+        THROW_HW_ERROR(NotSupported) << "No strobe on GPIO pin " << pin;
+
+    if (mode != StrobeOff)
+    {
+        if (delay < info.minValue || delay > info.maxValue)
+            THROW_HW_ERROR(InvalidValue) << "Strobe delay out of range: " << DEB_VAR1(delay);
+        if (mode == StrobeFixedDuration &&
+            (duration <= 0 || duration < info.minValue || duration > info.maxValue))
+            THROW_HW_ERROR(InvalidValue) << "Strobe duration out of range: " << DEB_VAR1(duration);
+        if (polarity == StrobeActiveHigh && !info.polaritySupported)
+            THROW_HW_ERROR(NotSupported) << "Strobe polarity not supported on GPIO pin " << pin;
+        setGpioDirection(pin, GpioOutput);
+    }
+
+    FlyCapture2::StrobeControl strobe;
+    strobe.source = pin;
+    strobe.onOff = (mode != StrobeOff);
+    strobe.polarity = (polarity == StrobeActiveHigh) ? 1 : 0;
+    strobe.delay = delay;
+    // a zero duration follows the exposure
+    strobe.duration = (mode == StrobeFixedDuration) ? duration : 0;
+    m_error = m_camera->SetStrobe(&strobe);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to set strobe: " << m_error.GetDescription();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getStrobeRange(int pin, double& min_value, double& max_value)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(pin);
+    _checkGpioPin(pin);
+
+    FlyCapture2::StrobeInfo info;
+    info.source = pin;
+    m_error = m_camera->GetStrobeInfo(&info);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to get strobe info: " << m_error.GetDescription();
+    if (!info.present)
+        THROW_HW_ERROR(NotSupported) << "No strobe on GPIO pin " << pin;
+
+    min_value = info.minValue;
+    max_value = info.maxValue;
+    DEB_RETURN() << DEB_VAR2(min_value, max_value);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getGpioDirection(int pin, GpioDirection& direction)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(pin);
+    _checkGpioPin(pin);
+
+    unsigned int value;
+    m_error = m_camera->GetGPIOPinDirection(pin, &value);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to get GPIO direction: " << m_error.GetDescription();
+
+    direction = value ? GpioOutput : GpioInput;
+    DEB_RETURN() << DEB_VAR1(direction);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setGpioDirection(int pin, GpioDirection direction)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(pin, direction);
+    _checkGpioPin(pin);
+
+    m_error = m_camera->SetGPIOPinDirection(pin, (direction == GpioOutput) ? 1 : 0);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to set GPIO direction: " << m_error.GetDescription();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getGpioMetadataActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_gpio_metadata_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+// the line states are embedded by the camera in the first pixels of
+// each frame, sampled at exposure start
+//-----------------------------------------------------
+void Camera::setGpioMetadataActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    if (active && !m_camera)
+        THROW_HW_ERROR(NotSupported) << "No camera connected";
+    m_gpio_metadata_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_checkGpioPin(int pin)
+{
+    DEB_MEMBER_FUNCT();
+    if (!m_camera)
+        THROW_HW_ERROR(NotSupported) << "No camera connected";
+    if (pin < 0 || pin >= k_NbGpioPins)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(pin);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_applyEmbeddedImageInfo()
+{
+    DEB_MEMBER_FUNCT();
+    FlyCapture2::EmbeddedImageInfo info;
+    m_error = m_camera->GetEmbeddedImageInfo(&info);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to get embedded image info: " << m_error.GetDescription();
+
+    if (m_gpio_metadata_active && !info.GPIOPinState.available)
+        THROW_HW_ERROR(NotSupported) << "Camera cannot embed GPIO states";
+    // the frame counter is embedded whenever available, for the frame metadata and the recorder index
+    m_frame_counter_active = info.frameCounter.available;
+    // GigE frames carry the device timestamp, the others only the host arrival time
+    // unless the camera cycle timer is embedded
+    m_embedded_timestamp_active = !m_gige_camera && info.timestamp.available;
+    // a sequence tags each frame with the shutter and gain it was exposed with
+    m_embedded_settings_active = m_seq_active && !m_seq_steps.empty() &&
+                                 info.shutter.available && info.gain.available;
+    if (info.GPIOPinState.onOff == m_gpio_metadata_active &&
+        info.frameCounter.onOff == m_frame_counter_active &&
+        info.timestamp.onOff == m_embedded_timestamp_active &&
+        info.shutter.onOff == m_embedded_settings_active &&
+        info.gain.onOff == m_embedded_settings_active)
+        return;
+
+    info.GPIOPinState.onOff = m_gpio_metadata_active;
+    info.frameCounter.onOff = m_frame_counter_active;
+    info.timestamp.onOff = m_embedded_timestamp_active;
+    info.shutter.onOff = m_embedded_settings_active;
+    info.gain.onOff = m_embedded_settings_active;
+    m_error = m_camera->SetEmbeddedImageInfo(&info);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to set embedded image info: " << m_error.GetDescription();
+}
+
+//-----------------------------------------------------
+// IEEE 1588 and clock model
+//-----------------------------------------------------
+void Camera::getPtpStatus(PtpStatus& status)
+{
+    DEB_MEMBER_FUNCT();
+    status = PtpNotSupported;
+    if (m_gige_camera)
+    {
+        unsigned int value;
+        m_error = m_gige_camera->ReadGVCPRegister(k_GVCPCapabilityReg, &value);
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Failed to read GVCP capability: " << m_error.GetDescription();
+        if (value & k_GVCPPtpBit)
+        {
+            m_error = m_gige_camera->ReadGVCPRegister(k_GVCPConfigReg, &value);
+            if (m_error != FlyCapture2::PGRERROR_OK)
+                THROW_HW_ERROR(Error) << "Failed to read GVCP configuration: " << m_error.GetDescription();
+            status = (value & k_GVCPPtpBit) ? PtpEnabled : PtpDisabled;
+        }
+    }
+    DEB_RETURN() << DEB_VAR1(status);
+}
+
+//-----------------------------------------------------
+// the camera clock steps when it locks, so the clock model restarts
+//-----------------------------------------------------
+void Camera::setPtpActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    PtpStatus status;
+    getPtpStatus(status);
+    if (status == PtpNotSupported)
+        THROW_HW_ERROR(NotSupported) << "IEEE 1588 is not supported by the camera";
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+
+    unsigned int value;
+    m_error = m_gige_camera->ReadGVCPRegister(k_GVCPConfigReg, &value);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to read GVCP configuration: " << m_error.GetDescription();
+
+    value = active ? (value | k_GVCPPtpBit) : (value & ~k_GVCPPtpBit);
+    m_error = m_gige_camera->WriteGVCPRegister(k_GVCPConfigReg, value);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to write GVCP configuration: " << m_error.GetDescription();
+
+    m_clock_model.reset();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getClockModelWindow(int& nb_samples)
+{
+    DEB_MEMBER_FUNCT();
+    nb_samples = m_clock_model.getWindow();
+    DEB_RETURN() << DEB_VAR1(nb_samples);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setClockModelWindow(int nb_samples)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_samples);
+    m_clock_model.setWindow(nb_samples);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getClockModelSampleInterval(double& interval)
+{
+    DEB_MEMBER_FUNCT();
+    interval = m_clock_model.getSampleInterval();
+    DEB_RETURN() << DEB_VAR1(interval);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setClockModelSampleInterval(double interval)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(interval);
+    m_clock_model.setSampleInterval(interval);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getClockModelStats(ClockModel::Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_clock_model.getStats(stats);
+    DEB_RETURN() << DEB_VAR4(stats.nb_samples, stats.offset, stats.drift, stats.jitter);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::resetClockModel()
+{
+    DEB_MEMBER_FUNCT();
+    m_clock_model.reset();
+}
+
+//-----------------------------------------------------
+// exposure/gain sequencer
+//-----------------------------------------------------
+void Camera::clearExpGainSequence()
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_seq_steps.clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::addExpGainStep(double exp_time, double gain)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(exp_time, gain);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+
+    double min_value, max_value;
+    _getPropertyRange(FlyCapture2::SHUTTER, min_value, max_value);
+    if (exp_time < min_value || exp_time > max_value)
+        THROW_HW_ERROR(InvalidValue) << "Exposure time out of range: " << DEB_VAR1(exp_time);
+    _getPropertyRange(FlyCapture2::GAIN, min_value, max_value);
+    if (gain < min_value || gain > max_value)
+        THROW_HW_ERROR(InvalidValue) << "Gain out of range: " << DEB_VAR1(gain);
+
+    _SeqStep step;
+    step.exp_time = exp_time;
+    step.gain = gain;
+    m_seq_steps.push_back(step);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getNbExpGainSteps(int& nb_steps)
+{
+    DEB_MEMBER_FUNCT();
+    nb_steps = m_seq_steps.size();
+    DEB_RETURN() << DEB_VAR1(nb_steps);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getExpGainStep(int step, double& exp_time, double& gain)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(step);
+    if (step < 0 || step >= int(m_seq_steps.size()))
+        THROW_HW_ERROR(InvalidValue) << "Invalid sequence step: " << DEB_VAR1(step);
+    exp_time = m_seq_steps[step].exp_time;
+    gain = m_seq_steps[step].gain;
+    DEB_RETURN() << DEB_VAR2(exp_time, gain);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getExpGainSequenceActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_seq_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setExpGainSequenceActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_seq_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getExpGainSequenceOnDevice(bool& on_device)
+{
+    DEB_MEMBER_FUNCT();
+    on_device = m_seq_on_device;
+    DEB_RETURN() << DEB_VAR1(on_device);
+}
+
+//-----------------------------------------------------
+// dark/flat-field correction
+//-----------------------------------------------------
+void Camera::setDarkMap(const float *map, const Size& size)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_correction.setDarkMap(map, size);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::clearDarkMap()
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_correction.clearDarkMap();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setGainMap(const float *map, const Size& size)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_correction.setGainMap(map, size);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::clearGainMap()
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_correction.clearGainMap();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCorrectionActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_correction_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setCorrectionActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (active == m_correction_active)
+        return;
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_correction_active = active;
+    _imageTypeChanged();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCorrectionImageType(ImageType& type)
+{
+    DEB_MEMBER_FUNCT();
+    type = m_correction.getOutputImageType();
+    DEB_RETURN() << DEB_VAR1(type);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setCorrectionImageType(ImageType type)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(type);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_correction.setOutputImageType(type);
+    if (m_correction_active)
+        _imageTypeChanged();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCorrectionNbThreads(int& nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    nb_threads = m_correction.getNbThreads();
+    DEB_RETURN() << DEB_VAR1(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setCorrectionNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_correction.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+// sub-frame accumulation
+//-----------------------------------------------------
+void Camera::getAccumulationActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_accumulation_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAccumulationActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (active == m_accumulation_active)
+        return;
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_accumulation_active = active;
+    _imageTypeChanged();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getAccumulationNbSubFrames(int& nb_sub_frames)
+{
+    DEB_MEMBER_FUNCT();
+    nb_sub_frames = m_accumulator.getNbSubFrames();
+    DEB_RETURN() << DEB_VAR1(nb_sub_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAccumulationNbSubFrames(int nb_sub_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_sub_frames);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_accumulator.setNbSubFrames(nb_sub_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getAccumulationSaturationLevel(int& level)
+{
+    DEB_MEMBER_FUNCT();
+    level = m_accumulator.getSaturationLevel();
+    DEB_RETURN() << DEB_VAR1(level);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAccumulationSaturationLevel(int level)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(level);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_accumulator.setSaturationLevel(level);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getAccumulationNbThreads(int& nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    nb_threads = m_accumulator.getNbThreads();
+    DEB_RETURN() << DEB_VAR1(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAccumulationNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_accumulator.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getAccumulationStats(Accumulator::Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_accumulator.getStats(stats);
+}
+
+//-----------------------------------------------------
+// beam analysis
+//-----------------------------------------------------
+void Camera::getBeamAnalysisActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_beam_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setBeamAnalysisActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_beam_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setBeamBackgroundMap(const float *map, const Size& size)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_beam_analyzer.setBackgroundMap(map, size);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::clearBeamBackgroundMap()
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_beam_analyzer.clearBackgroundMap();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getBeamBackgroundLevel(double& level)
+{
+    DEB_MEMBER_FUNCT();
+    level = m_beam_analyzer.getBackgroundLevel();
+    DEB_RETURN() << DEB_VAR1(level);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setBeamBackgroundLevel(double level)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(level);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_beam_analyzer.setBackgroundLevel(level);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getBeamThreshold(double& threshold)
+{
+    DEB_MEMBER_FUNCT();
+    threshold = m_beam_analyzer.getThreshold();
+    DEB_RETURN() << DEB_VAR1(threshold);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setBeamThreshold(double threshold)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(threshold);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_beam_analyzer.setThreshold(threshold);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getBeamAnalysisNbThreads(int& nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    nb_threads = m_beam_analyzer.getNbThreads();
+    DEB_RETURN() << DEB_VAR1(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setBeamAnalysisNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_beam_analyzer.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getBeamSeriesSize(int& nb_results)
+{
+    DEB_MEMBER_FUNCT();
+    nb_results = m_beam_analyzer.getSeriesSize();
+    DEB_RETURN() << DEB_VAR1(nb_results);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setBeamSeriesSize(int nb_results)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_results);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_beam_analyzer.setSeriesSize(nb_results);
+}
+
+//-----------------------------------------------------
+// lock-free, callable at frame rate during the acquisition
+//-----------------------------------------------------
+void Camera::getBeamResult(int acq_frame_nb, BeamAnalyzer::Result& result)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(acq_frame_nb);
+    if (!m_beam_analyzer.getResult(acq_frame_nb, result))
+        THROW_HW_ERROR(InvalidValue) << "Beam result not available: " << DEB_VAR1(acq_frame_nb);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getLastBeamResult(BeamAnalyzer::Result& result)
+{
+    DEB_MEMBER_FUNCT();
+    if (!m_beam_analyzer.getLastResult(result))
+        THROW_HW_ERROR(Error) << "No beam result yet";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getBeamSeries(int first_frame_nb, int max_nb, std::string& data)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(first_frame_nb, max_nb);
+    m_beam_analyzer.getSeries(first_frame_nb, max_nb, data);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getBeamAnalysisStats(BeamAnalyzer::Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_beam_analyzer.getStats(stats);
+}
+
+//-----------------------------------------------------
+// region counters
+//-----------------------------------------------------
+void Camera::getRoiCountersActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_roi_counters_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setRoiCountersActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_roi_counters_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::clearRoiCounters()
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_roi_counters.clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::addRoiCounter(const Roi& roi, int& index)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(roi);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    index = m_roi_counters.add(roi);
+    DEB_RETURN() << DEB_VAR1(index);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getNbRoiCounters(int& nb_rois)
+{
+    DEB_MEMBER_FUNCT();
+    nb_rois = m_roi_counters.getNbRois();
+    DEB_RETURN() << DEB_VAR1(nb_rois);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getRoiCounter(int index, Roi& roi)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(index);
+    roi = m_roi_counters.getRoi(index);
+    DEB_RETURN() << DEB_VAR1(roi);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getRoiCounterSeriesSize(int& nb_records)
+{
+    DEB_MEMBER_FUNCT();
+    nb_records = m_roi_counters.getSeriesSize();
+    DEB_RETURN() << DEB_VAR1(nb_records);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setRoiCounterSeriesSize(int nb_records)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_records);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_roi_counters.setSeriesSize(nb_records);
+}
+
+//-----------------------------------------------------
+// lock-free, callable at frame rate during the acquisition
+//-----------------------------------------------------
+void Camera::getRoiCounterValues(int acq_frame_nb, int index,
+                                 double& sum, double& mean, double& min_value, double& max_value)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(acq_frame_nb, index);
+    // regions of the last prepared acquisition
+    int nb_rois = (m_roi_counters.getRecordSize() - RoiCounters::k_NbHeaderFields) /
+                  RoiCounters::k_NbRoiFields;
+    if (index < 0 || index >= nb_rois)
+        THROW_HW_ERROR(InvalidValue) << "Invalid counter region: " << DEB_VAR1(index);
+    std::vector<double> record(m_roi_counters.getRecordSize());
+    if (!m_roi_counters.getRecord(acq_frame_nb, &record[0]))
+        THROW_HW_ERROR(InvalidValue) << "Counters not available: " << DEB_VAR1(acq_frame_nb);
+    const double *counter = &record[RoiCounters::k_NbHeaderFields + index * RoiCounters::k_NbRoiFields];
+    sum = counter[0];
+    mean = counter[1];
+    min_value = counter[2];
+    max_value = counter[3];
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getRoiCounterSeries(int first_frame_nb, int max_nb, std::string& data)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(first_frame_nb, max_nb);
+    m_roi_counters.getSeries(first_frame_nb, max_nb, data);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getRoiCounterStats(RoiCounters::Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_roi_counters.getStats(stats);
+}
+
+//-----------------------------------------------------
+// frame selection
+//-----------------------------------------------------
+void Camera::getSelectionActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_selection_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setSelectionActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_selection_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getSelectionCriterion(FrameSelector::Criterion& criterion)
+{
+    DEB_MEMBER_FUNCT();
+    criterion = m_frame_selector.getCriterion();
+    DEB_RETURN() << DEB_VAR1(criterion);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setSelectionCriterion(FrameSelector::Criterion criterion)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(criterion);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_frame_selector.setCriterion(criterion);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getSelectionThreshold(double& threshold)
+{
+    DEB_MEMBER_FUNCT();
+    threshold = m_frame_selector.getThreshold();
+    DEB_RETURN() << DEB_VAR1(threshold);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setSelectionThreshold(double threshold)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(threshold);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_frame_selector.setThreshold(threshold);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getSelectionRegion(Roi& region)
+{
+    DEB_MEMBER_FUNCT();
+    region = m_frame_selector.getRegion();
+    DEB_RETURN() << DEB_VAR1(region);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setSelectionRegion(const Roi& region)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(region);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_frame_selector.setRegion(region);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getSelectionNbPreFrames(int& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_frame_selector.getNbPreFrames();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setSelectionNbPreFrames(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_frame_selector.setNbPreFrames(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getSelectionNbPostFrames(int& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_frame_selector.getNbPostFrames();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setSelectionNbPostFrames(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_frame_selector.setNbPostFrames(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getSelectionStats(FrameSelector::Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_frame_selector.getStats(stats);
+}
+
+//-----------------------------------------------------
+// pre-trigger event history
+//-----------------------------------------------------
+void Camera::getEventHistoryActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_event_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setEventHistoryActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_event_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getEventNbPreFrames(int& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_event_history.getCapacity();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setEventNbPreFrames(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_event_history.setCapacity(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getEventNbPostFrames(int& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_event_nb_post_frames;
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setEventNbPostFrames(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    if (nb_frames < 0)
+        THROW_HW_ERROR(InvalidValue) << "Invalid number of post frames: " << DEB_VAR1(nb_frames);
+    m_event_nb_post_frames = nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getEventGpioPin(int& pin)
+{
+    DEB_MEMBER_FUNCT();
+    pin = m_event_gpio_pin;
+    DEB_RETURN() << DEB_VAR1(pin);
+}
+
+//-----------------------------------------------------
+// -1 disables the hardware events
+//-----------------------------------------------------
+void Camera::setEventGpioPin(int pin)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(pin);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    if (pin >= 0)
+        _checkGpioPin(pin);
+    m_event_gpio_pin = pin;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getEventGpioEdge(EventEdge& edge)
+{
+    DEB_MEMBER_FUNCT();
+    edge = m_event_gpio_edge;
+    DEB_RETURN() << DEB_VAR1(edge);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setEventGpioEdge(EventEdge edge)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(edge);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_event_gpio_edge = edge;
+}
+
+//-----------------------------------------------------
+// taken into account on the next frame
+//-----------------------------------------------------
+void Camera::triggerEvent()
+{
+    DEB_MEMBER_FUNCT();
+    if (!m_event_active)
+        THROW_HW_ERROR(Error) << "Event history is not active";
+    m_event_pending = true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getEventStats(EventStats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_published_event_stats.load(stats);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getFramePublishActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_frame_publish_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setFramePublishActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_frame_publish_active = active;
+}
+
+//-----------------------------------------------------
+// defective pixel correction
+//-----------------------------------------------------
+void Camera::clearDefectMap()
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_defect_map.clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::addDefectPixel(int x, int y)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_defect_map.addPixel(x, y);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setDefectMask(const unsigned char *mask, const Size& size)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_defect_map.setMask(mask, size);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getNbDefectPixels(int& nb_pixels)
+{
+    DEB_MEMBER_FUNCT();
+    nb_pixels = m_defect_map.getNbPixels();
+    DEB_RETURN() << DEB_VAR1(nb_pixels);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getDefectCorrectionActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_defect_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setDefectCorrectionActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_defect_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getDefectCorrectionMode(DefectMode& mode)
+{
+    DEB_MEMBER_FUNCT();
+    mode = (m_defect_map.getMode() == DefectMap::Mean) ? DefectMean : DefectMedian;
+    DEB_RETURN() << DEB_VAR1(mode);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setDefectCorrectionMode(DefectMode mode)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(mode);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_defect_map.setMode((mode == DefectMean) ? DefectMap::Mean : DefectMap::Median);
+}
+
+//-----------------------------------------------------
+// the map is built from the next acquisition, taken in the dark
+//-----------------------------------------------------
+void Camera::buildDefectMap(int nb_frames, double nb_sigma)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(nb_frames, nb_sigma);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_defect_map.startBuild(nb_frames, nb_sigma);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getDefectMapBuilding(bool& building)
+{
+    DEB_MEMBER_FUNCT();
+    building = m_defect_map.isBuilding();
+    DEB_RETURN() << DEB_VAR1(building);
+}
+
+//-----------------------------------------------------
+// compression side channel
+//-----------------------------------------------------
+void Camera::getCompressionActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_compression_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setCompressionActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_compression_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCompressionNbThreads(int& nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    nb_threads = m_compressor.getNbThreads();
+    DEB_RETURN() << DEB_VAR1(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setCompressionNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_compressor.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCompressionChunkSize(int& chunk_size)
+{
+    DEB_MEMBER_FUNCT();
+    chunk_size = m_compressor.getChunkSize();
+    DEB_RETURN() << DEB_VAR1(chunk_size);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setCompressionChunkSize(int chunk_size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(chunk_size);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_compressor.setChunkSize(chunk_size);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCompressionRingSize(int& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_compressor.getRingSize();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setCompressionRingSize(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_compressor.setRingSize(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCompressedFrame(int acq_frame_nb, std::string& data)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(acq_frame_nb);
+    m_compressor.getFrame(acq_frame_nb, data);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCompressedFrameSize(int acq_frame_nb, int& size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(acq_frame_nb);
+    size = m_compressor.getFrameSize(acq_frame_nb);
+    DEB_RETURN() << DEB_VAR1(size);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCompressionStats(Compressor::Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_compressor.getStats(stats);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::decompressFrame(const std::string& data, std::string& raw)
+{
+    DEB_STATIC_FUNCT();
+    Compressor::decompress(data.data(), data.size(), raw);
+}
+
+//-----------------------------------------------------
+// direct-to-disk recorder
+//-----------------------------------------------------
+void Camera::getRecorderActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_recorder_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setRecorderActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_recorder_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getRecorderFileName(std::string& file_name)
+{
+    DEB_MEMBER_FUNCT();
+    file_name = m_recorder.getFileName();
+    DEB_RETURN() << DEB_VAR1(file_name);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setRecorderFileName(const std::string& file_name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(file_name);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_recorder.setFileName(file_name);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getRecorderNbBuffers(int& nb_buffers)
+{
+    DEB_MEMBER_FUNCT();
+    nb_buffers = m_recorder.getNbBuffers();
+    DEB_RETURN() << DEB_VAR1(nb_buffers);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setRecorderNbBuffers(int nb_buffers)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_buffers);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_recorder.setNbBuffers(nb_buffers);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getRecorderBufferSize(int& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_recorder.getBufferSize();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setRecorderBufferSize(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_recorder.setBufferSize(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getRecorderStats(Recorder::Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_recorder.getStats(stats);
+}
+
+//-----------------------------------------------------
+// shared memory publisher
+//-----------------------------------------------------
+void Camera::getShmActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_shm_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+// the segment is created at prepareAcq and removed when disabled
+//-----------------------------------------------------
+void Camera::setShmActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_shm_active = active;
+    if (!active)
+        m_shm_publisher.close();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getShmName(std::string& name)
+{
+    DEB_MEMBER_FUNCT();
+    name = m_shm_publisher.getName();
+    DEB_RETURN() << DEB_VAR1(name);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setShmName(const std::string& name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(name);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_shm_publisher.setName(name);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getShmNbSlots(int& nb_slots)
+{
+    DEB_MEMBER_FUNCT();
+    nb_slots = m_shm_publisher.getNbSlots();
+    DEB_RETURN() << DEB_VAR1(nb_slots);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setShmNbSlots(int nb_slots)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_slots);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_shm_publisher.setNbSlots(nb_slots);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getShmStats(ShmPublisher::Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_shm_publisher.getStats(stats);
+}
+
+//-----------------------------------------------------
+// TCP streaming
+//-----------------------------------------------------
+void Camera::getStreamActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_streamer.isRunning();
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+// the server runs independently of the acquisitions
+//-----------------------------------------------------
+void Camera::setStreamActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (active)
+        m_streamer.start();
+    else
+        m_streamer.stop();
+}
+
+//-----------------------------------------------------
+// the bound port while active, 0 picks a free port
+//-----------------------------------------------------
+void Camera::getStreamPort(int& port)
+{
+    DEB_MEMBER_FUNCT();
+    port = m_streamer.isRunning() ? m_streamer.getBoundPort() : m_streamer.getPort();
+    DEB_RETURN() << DEB_VAR1(port);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setStreamPort(int port)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(port);
+    if (m_streamer.isRunning())
+        THROW_HW_ERROR(Error) << "Stream server is running";
+    m_streamer.setPort(port);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getStreamDecimation(int& decimation)
+{
+    DEB_MEMBER_FUNCT();
+    decimation = m_streamer.getDecimation();
+    DEB_RETURN() << DEB_VAR1(decimation);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setStreamDecimation(int decimation)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(decimation);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_streamer.setDecimation(decimation);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getStreamCompression(bool& compression)
+{
+    DEB_MEMBER_FUNCT();
+    compression = m_streamer.getCompression();
+    DEB_RETURN() << DEB_VAR1(compression);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setStreamCompression(bool compression)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(compression);
+    m_streamer.setCompression(compression);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getStreamQueueDepth(int& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_streamer.getQueueDepth();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setStreamQueueDepth(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (m_streamer.isRunning())
+        THROW_HW_ERROR(Error) << "Stream server is running";
+    m_streamer.setQueueDepth(nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getStreamNbClients(int& nb_clients)
+{
+    DEB_MEMBER_FUNCT();
+    nb_clients = m_streamer.getNbClients();
+    DEB_RETURN() << DEB_VAR1(nb_clients);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getStreamClientStats(int client, Streamer::ClientStats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(client);
+    m_streamer.getClientStats(client, stats);
+}
+
+//-----------------------------------------------------
+// replay
+//-----------------------------------------------------
+void Camera::getReplayFile(std::string& file_name)
+{
+    DEB_MEMBER_FUNCT();
+    file_name = m_replay.getFileName();
+    DEB_RETURN() << DEB_VAR1(file_name);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setReplayFile(const std::string& file_name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(file_name);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_replay.open(file_name);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getReplayActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_replay_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setReplayActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    if (!active && !m_camera)
+        THROW_HW_ERROR(Error) << "No camera connected";
+    m_replay_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getReplayPacing(ReplayPacing& pacing)
+{
+    DEB_MEMBER_FUNCT();
+    pacing = ReplayPacing(m_replay.getPacing());
+    DEB_RETURN() << DEB_VAR1(pacing);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setReplayPacing(ReplayPacing pacing)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(pacing);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    switch (pacing)
+    {
+    case ReplayRecorded:
+        m_replay.setPacing(Replay::Recorded);
+        break;
+    case ReplayAsFastAsPossible:
+        m_replay.setPacing(Replay::AsFastAsPossible);
+        break;
+    case ReplayFixedRate:
+        m_replay.setPacing(Replay::FixedRate);
+        break;
+    default:
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(pacing);
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getReplayFrameRate(double& frame_rate)
+{
+    DEB_MEMBER_FUNCT();
+    frame_rate = m_replay.getFrameRate();
+    DEB_RETURN() << DEB_VAR1(frame_rate);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setReplayFrameRate(double frame_rate)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(frame_rate);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_replay.setFrameRate(frame_rate);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getReplayLoop(bool& loop)
+{
+    DEB_MEMBER_FUNCT();
+    loop = m_replay.getLoop();
+    DEB_RETURN() << DEB_VAR1(loop);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setReplayLoop(bool loop)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(loop);
+    if (m_acq_started)
+        THROW_HW_ERROR(Error) << "Acquisition in progress";
+    m_replay.setLoop(loop);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getReplayNbFrames(int& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_replay.getNbFrames();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+// can be toggled during the acquisition
+//-----------------------------------------------------
+void Camera::getTraceActive(bool& active)
+{
+    DEB_MEMBER_FUNCT();
+    active = m_tracer.isActive();
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setTraceActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    m_tracer.setActive(active);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getTraceBufferSize(int& nb_events)
+{
+    DEB_MEMBER_FUNCT();
+    nb_events = m_tracer.getBufferSize();
+    DEB_RETURN() << DEB_VAR1(nb_events);
+}
+
+//-----------------------------------------------------
+// applies to the threads not traced yet
+//-----------------------------------------------------
+void Camera::setTraceBufferSize(int nb_events)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_events);
+    m_tracer.setBufferSize(nb_events);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::clearTrace()
+{
+    DEB_MEMBER_FUNCT();
+    m_tracer.clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::dumpTrace(const std::string& file_name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(file_name);
+    m_tracer.dump(file_name);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getTraceStats(Tracer::Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    m_tracer.getStats(stats);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getFrameMetadata(int acq_frame_nb, FrameMetadata& metadata)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(acq_frame_nb);
+    int nb_metadata = m_frame_metadata.size();
+    if (acq_frame_nb < 0 || acq_frame_nb >= m_image_number ||
+        acq_frame_nb < m_image_number - nb_metadata)
+        THROW_HW_ERROR(InvalidValue) << "Frame metadata not available: " << DEB_VAR1(acq_frame_nb);
+    metadata = m_frame_metadata[acq_frame_nb % nb_metadata];
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_prepareExpGainSequence()
+{
+    DEB_MEMBER_FUNCT();
+    if (m_seq_on_device)
+        _disableDeviceSequence();
+    m_seq_counter_started = false;
+
+    if (!m_seq_active || m_seq_steps.empty())
+        return;
+
+    if (m_camera)
+    {
+        for (unsigned int i = 0; i < m_seq_steps.size(); ++i)
+        {
+            _SeqStep& step = m_seq_steps[i];
+            step.raw_shutter = _getRawPropertyValue(FlyCapture2::SHUTTER, step.exp_time);
+            step.raw_gain = _getRawPropertyValue(FlyCapture2::GAIN, step.gain);
+        }
+    }
+
+    // Prefer the camera HDR register sets, the sequence then runs at full rate
+    // without any register write between frames
+    m_seq_on_device = _programDeviceSequence();
+
+    // A host write only reaches the sensor a few frames later and frames can be
+    // dropped meanwhile, host driven frames are tagged from the embedded settings
+    if (m_camera && !m_seq_on_device && !m_embedded_settings_active)
+        THROW_HW_ERROR(NotSupported) << "Camera cannot embed shutter and gain, "
+                                     << "host driven sequence frames cannot be tagged";
+
+    // A host driven sequence starts from the first step, the acquisition thread
+    // then writes the next step at each raw frame
+    if (!m_seq_on_device)
+    {
+        const _SeqStep& first = m_seq_steps.front();
+        _setPropertyValue(FlyCapture2::SHUTTER, first.exp_time);
+        _setPropertyValue(FlyCapture2::GAIN, first.gain);
+    }
+
+    DEB_TRACE() << "Exposure/gain sequence of " << m_seq_steps.size() << " steps"
+                << (m_seq_on_device ? " on device" : " driven by host");
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool Camera::_programDeviceSequence()
+{
+    DEB_MEMBER_FUNCT();
+    unsigned int nb_steps = m_seq_steps.size();
+    if (!m_camera || nb_steps < 2 || k_HDRNbSets % nb_steps)
+        return false;
+
+    unsigned int value = 0;
+    m_error = m_camera->ReadRegister(k_HDRCtrlReg, &value);
+    if (m_error != FlyCapture2::PGRERROR_OK || !(value & k_HDRPresent))
+        return false;
+
+    for (unsigned int i = 0; i < k_HDRNbSets; ++i)
+    {
+        const _SeqStep& step = m_seq_steps[i % nb_steps];
+        m_error = m_camera->WriteRegister(k_HDRShutterReg + i * k_HDRSetOffset, step.raw_shutter);
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Failed to write HDR shutter register: " << m_error.GetDescription();
+        m_error = m_camera->WriteRegister(k_HDRGainReg + i * k_HDRSetOffset, step.raw_gain);
+        if (m_error != FlyCapture2::PGRERROR_OK)
+            THROW_HW_ERROR(Error) << "Failed to write HDR gain register: " << m_error.GetDescription();
+    }
+
+    m_error = m_camera->WriteRegister(k_HDRCtrlReg, k_HDRPresent | k_HDROn);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to enable HDR mode: " << m_error.GetDescription();
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_disableDeviceSequence()
+{
+    DEB_MEMBER_FUNCT();
+    m_seq_on_device = false;
+    m_error = m_camera->WriteRegister(k_HDRCtrlReg, k_HDRPresent);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        DEB_ERROR() << "Failed to disable HDR mode: " << m_error.GetDescription();
+}
+
+//-----------------------------------------------------
+// host driven sequence, the step of the next exposure is written once per raw frame
+//-----------------------------------------------------
+bool Camera::_advanceExpGainSequence(int frame_nb)
+{
+    DEB_MEMBER_FUNCT();
+    int nb_steps = m_seq_steps.size();
+    if (!m_seq_active || m_seq_on_device || nb_steps < 2)
+        return true;
+
+    const _SeqStep& next = m_seq_steps[(frame_nb + 1) % nb_steps];
+    try
+    {
+        _setPropertyValue(FlyCapture2::SHUTTER, next.exp_time);
+        _setPropertyValue(FlyCapture2::GAIN, next.gain);
+    }
+    catch (Exception& e)
+    {
+        DEB_ERROR() << "Sequencer failed: " << e.getErrDesc();
+        _setStatus(Camera::Fault, false);
+        return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------
+// Convert an absolute property value to the raw register value, the camera
+// does the conversion and the property is restored afterwards
+//-----------------------------------------------------
+unsigned int Camera::_getRawPropertyValue(FlyCapture2::PropertyType type, double value)
+{
+    DEB_MEMBER_FUNCT();
+    FlyCapture2::Property saved(type);
+    m_error = m_camera->GetProperty(&saved);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to get camera property: " << m_error.GetDescription();
+
+    _setPropertyValue(type, value);
+
+    FlyCapture2::Property property(type);
+    m_error = m_camera->GetProperty(&property);
+    FlyCapture2::Error restore_error = m_camera->SetProperty(&saved);
+    if (m_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to get camera property: " << m_error.GetDescription();
+    if (restore_error != FlyCapture2::PGRERROR_OK)
+        THROW_HW_ERROR(Error) << "Failed to restore camera property: " << restore_error.GetDescription();
+
+    return property.valueA;
+}
+
+//-----------------------------------------------------
+// property management
+//-----------------------------------------------------
+void Camera::_getPropertyValue(FlyCapture2::PropertyType type, double& value)
+{
+    DEB_MEMBER_FUNCT();
+    if (!m_camera)
+    {
+        value = _getSimProperty(type).value;
+        return;
+    }
+
     FlyCapture2::Property property(type);
 
     m_error = m_camera->GetProperty(&property);
@@ -701,6 +3923,17 @@ void Camera::_getPropertyValue(FlyCapture2::PropertyType type, double& value)
 void Camera::_setPropertyValue(FlyCapture2::PropertyType type, double value)
 {
     DEB_MEMBER_FUNCT();
+    POINTGREY_TRACE(m_tracer, "setProperty", type);
+    if (!m_camera)
+    {
+        _SimProperty& sim = _getSimProperty(type);
+        if (value < sim.min_value || value > sim.max_value)
+            THROW_HW_ERROR(InvalidValue) << "Property value out of range: " << DEB_VAR1(value);
+        sim.value = value;
+        sim.auto_mode = false;
+        return;
+    }
+
     FlyCapture2::Property property(type);
 
     property.onOff = true;
@@ -719,6 +3952,14 @@ void Camera::_setPropertyValue(FlyCapture2::PropertyType type, double value)
 void Camera::_getPropertyRange(FlyCapture2::PropertyType type, double& min_value, double& max_value)
 {
     DEB_MEMBER_FUNCT();
+    if (!m_camera)
+    {
+        const _SimProperty& sim = _getSimProperty(type);
+        min_value = sim.min_value;
+        max_value = sim.max_value;
+        return;
+    }
+
     FlyCapture2::PropertyInfo property_info(type);
 
     m_error = m_camera->GetPropertyInfo(&property_info);
@@ -735,6 +3976,12 @@ void Camera::_getPropertyRange(FlyCapture2::PropertyType type, double& min_value
 void Camera::_getPropertyAutoMode(FlyCapture2::PropertyType type, bool& auto_mode)
 {
     DEB_MEMBER_FUNCT();
+    if (!m_camera)
+    {
+        auto_mode = _getSimProperty(type).auto_mode;
+        return;
+    }
+
     FlyCapture2::Property property(type);
 
     m_error = m_camera->GetProperty(&property);
@@ -750,6 +3997,13 @@ void Camera::_getPropertyAutoMode(FlyCapture2::PropertyType type, bool& auto_mod
 void Camera::_setPropertyAutoMode(FlyCapture2::PropertyType type, bool auto_mode)
 {
     DEB_MEMBER_FUNCT();
+    POINTGREY_TRACE(m_tracer, "setPropertyAutoMode", type);
+    if (!m_camera)
+    {
+        _getSimProperty(type).auto_mode = auto_mode;
+        return;
+    }
+
     FlyCapture2::Property property(type);
 
     property.onOff = not auto_mode;
@@ -760,15 +4014,33 @@ void Camera::_setPropertyAutoMode(FlyCapture2::PropertyType type, bool auto_mode
         THROW_HW_ERROR(Error) << "Failed to set camera property: " << m_error.GetDescription();
 }
 
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Camera::_SimProperty& Camera::_getSimProperty(FlyCapture2::PropertyType type)
+{
+    DEB_MEMBER_FUNCT();
+    std::map<FlyCapture2::PropertyType, _SimProperty>::iterator it = m_sim_properties.find(type);
+    if (it == m_sim_properties.end())
+        THROW_HW_ERROR(NotSupported) << "Property " << type << " is not emulated in replay";
+    return it->second;
+}
+
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
 void Camera::_setStatus(Camera::Status status, bool force)
 {
     DEB_MEMBER_FUNCT();
-    AutoMutex alock(m_cond.mutex());
-    if (force || m_status != Camera::Fault)
-        m_status = status;
+    // steady state is a single load, a fault sticks unless forced
+    Camera::Status old_status = m_status.load(__ATOMIC_RELAXED);
+    do
+    {
+        if (old_status == status || (!force && old_status == Camera::Fault))
+            return;
+    }
+    while (!m_status.compareExchange(old_status, status));
+    _notifyEvent();
 }
 
 //-----------------------------------------------------
@@ -790,6 +4062,538 @@ void Camera::_forcePGRY16Mode()
         THROW_HW_ERROR(Error) << "Failed to write camera register: " << m_error.GetDescription();
 }
 
+//-----------------------------------------------------
+// frame retrieved from the camera
+//-----------------------------------------------------
+bool Camera::_processImage(FlyCapture2::Image& image)
+{
+    _RawFrame frame;
+    frame.data = image.GetData();
+    frame.stride = image.GetStride();
+    frame.type = (image.GetPixelFormat() == FlyCapture2::PIXEL_FORMAT_MONO16) ? Bpp16 : Bpp8;
+    frame.timestamp = Timestamp::now();
+    frame.camera_timestamp = _getCameraTimestamp(image);
+    frame.frame_counter = m_frame_counter_active ? int(image.GetMetadata().embeddedFrameCounter) : -1;
+    frame.gpio_state = m_gpio_metadata_active ? _getGpioState(image) : -1;
+    frame.seq_step = _getSeqStep(&image, frame.frame_counter);
+    return _processFrame(frame);
+}
+
+//-----------------------------------------------------
+// frame delivered on the driver thread in callback capture mode
+//-----------------------------------------------------
+void Camera::_imageCallback(FlyCapture2::Image *image, const void *data)
+{
+    Camera *cam = (Camera *) data;
+    // counted before the active flag is tested, so that _callbackLoop() can
+    // wait for the frame in flight once it has cleared the flag
+    ++cam->m_nb_running_callbacks;
+    if (cam->m_callback_active && !cam->_isAcqComplete())
+    {
+        cam->_setStatus(Camera::Readout, false);
+        bool continue_acq = cam->_processImage(*image);
+        if (!continue_acq || cam->_isAcqComplete())
+            cam->m_callback_active = false;
+    }
+    if (--cam->m_nb_running_callbacks == 0 && !cam->m_callback_active)
+    {
+        AutoMutex lock(cam->m_cond.mutex());
+        cam->m_cond.broadcast();
+    }
+}
+
+//-----------------------------------------------------
+// next frame of the replayed sequence, false once it is over
+//-----------------------------------------------------
+bool Camera::_processReplayFrame()
+{
+    DEB_MEMBER_FUNCT();
+    POINTGREY_TRACE(m_tracer, "replay", m_image_number);
+    Recorder::IndexRecord record;
+    _RawFrame frame;
+    if (!m_replay.next(frame.data, record))
+    {
+        DEB_TRACE() << "Replay over";
+        return false;
+    }
+    _setStatus(Camera::Readout, false);
+
+    const Recorder::SeqHeader& header = m_replay.getHeader();
+    frame.stride = header.frame_size / header.height;
+    frame.type = ImageType(header.image_type);
+    frame.timestamp = record.timestamp;
+    frame.camera_timestamp = record.camera_timestamp;
+    frame.frame_counter = record.frame_counter;
+    frame.gpio_state = -1;
+    frame.seq_step = _getSeqStep(NULL, frame.frame_counter);
+    return _processFrame(frame);
+}
+
+//-----------------------------------------------------
+// raw frame from the camera or the replay
+//-----------------------------------------------------
+bool Camera::_processFrame(const _RawFrame& frame)
+{
+    DEB_MEMBER_FUNCT();
+    POINTGREY_TRACE(m_tracer, "process", m_raw_frame_nb);
+    StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj.getBuffer();
+
+    // every camera frame feeds the clock model at arrival, whatever becomes of it
+    if (frame.camera_timestamp > 0.)
+        m_clock_model.addSample(frame.camera_timestamp, frame.timestamp);
+
+    _RawFrame raw = frame;
+    if (m_accumulation_active)
+    {
+        // sub-frames are summed in place into the next frame buffer
+        if (m_accumulator.isFrameStart())
+        {
+            if (!_waitFrameUnpinned())
+                return false;
+            m_accumulation_first = frame;
+        }
+        void* sumPt = buffer_mgr.getFrameBufferPtr(m_image_number);
+        bool frame_done;
+        {
+            POINTGREY_TRACE(m_tracer, "accumulate", m_image_number);
+            frame_done = m_accumulator.add(frame.data, frame.stride, sumPt);
+        }
+        if (!frame_done)
+            return true;
+
+        // stamped by its first sub-frame
+        raw = m_accumulation_first;
+        raw.data = sumPt;
+        raw.stride = buffer_mgr.getFrameDim().getSize().getWidth() * sizeof(unsigned int);
+        raw.type = Bpp32;
+        raw.nb_saturated_sub_frames = m_accumulator.getNbSaturatedSubFrames();
+        raw.max_saturated_pixels = m_accumulator.getMaxSaturatedPixels();
+    }
+    else
+        raw.nb_saturated_sub_frames = raw.max_saturated_pixels = 0;
+    raw.frame_nb = m_raw_frame_nb++;
+
+    // selected, held in history or published, every frame advances the sequence
+    if (!_advanceExpGainSequence(raw.frame_nb))
+        return false;
+
+    if (m_selection_active)
+        return _selectFrame(raw);
+    if (m_event_active)
+        return _eventFrame(raw);
+    return _publishFrame(raw);
+}
+
+//-----------------------------------------------------
+// the requested number of frames is published
+//-----------------------------------------------------
+bool Camera::_isAcqComplete() const
+{
+    return m_nb_frames && m_image_number >= m_nb_frames;
+}
+
+//-----------------------------------------------------
+// frames only go to the history until the criterion fires, the history
+// is then published first as pre-trigger context
+//-----------------------------------------------------
+bool Camera::_selectFrame(const _RawFrame& frame)
+{
+    DEB_MEMBER_FUNCT();
+    if (!m_frame_selector.select(frame.data, frame.stride))
+    {
+        _pushHistory(m_selection_history, frame);
+        return true;
+    }
+    return _dumpHistory(m_selection_history, frame);
+}
+
+//-----------------------------------------------------
+// frames go to the pre-trigger history until an event, which dumps it
+// with the event frame and the post frames
+//-----------------------------------------------------
+bool Camera::_eventFrame(const _RawFrame& frame)
+{
+    DEB_MEMBER_FUNCT();
+    bool event = m_event_pending.exchange(false);
+
+    int pin = m_event_gpio_pin;
+    if (pin >= 0 && frame.gpio_state >= 0)
+    {
+        int level = (frame.gpio_state >> pin) & 1;
+        if (m_event_gpio_level >= 0 && level != m_event_gpio_level)
+            event |= (level == (m_event_gpio_edge == EventRisingEdge ? 1 : 0));
+        m_event_gpio_level = level;
+    }
+
+    bool post = false;
+    ++m_event_stats.nb_frames;
+    if (event)
+    {
+        DEB_TRACE() << "Event at frame " << frame.frame_nb;
+        ++m_event_stats.nb_events;
+        m_event_stats.last_event_frame_nb = frame.frame_nb;
+        m_event_stats.nb_dumped_frames += m_event_history.getNbFrames() + 1;
+        m_event_post_left = m_event_nb_post_frames;
+    }
+    else if (m_event_post_left > 0)
+    {
+        --m_event_post_left;
+        ++m_event_stats.nb_dumped_frames;
+        post = true;
+    }
+    // the control thread only sees whole updates
+    m_published_event_stats.store(m_event_stats);
+
+    if (event)
+        return _dumpHistory(m_event_history, frame);
+    if (post)
+        return _publishFrame(frame);
+    _pushHistory(m_event_history, frame);
+    return true;
+}
+
+//-----------------------------------------------------
+// publish the history then the frame, and empty the history
+//-----------------------------------------------------
+bool Camera::_dumpHistory(FrameHistory& history, const _RawFrame& frame)
+{
+    DEB_MEMBER_FUNCT();
+    // an accumulated frame sits in the buffer the history frames go to first
+    bool in_buffer = m_accumulation_active && history.getNbFrames();
+    if (in_buffer)
+        _pushHistory(history, frame, true);
+
+    // the burst stops at the requested number of frames
+    bool continue_acq = true;
+    for (int i = 0; continue_acq && i < history.getNbFrames() && !_isAcqComplete(); ++i)
+    {
+        _RawFrame context;
+        _getHistoryFrame(history, i, context);
+        continue_acq = _publishFrame(context);
+    }
+    history.clear();
+
+    if (!in_buffer && continue_acq && !_isAcqComplete())
+        continue_acq = _publishFrame(frame);
+    return continue_acq && !_isAcqComplete();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_pushHistory(FrameHistory& history, const _RawFrame& frame, bool append)
+{
+    FrameHistory::Info info;
+    info.timestamp = frame.timestamp;
+    info.camera_timestamp = frame.camera_timestamp;
+    info.frame_counter = frame.frame_counter;
+    info.gpio_state = frame.gpio_state;
+    info.seq_step = frame.seq_step;
+    info.frame_nb = frame.frame_nb;
+    info.nb_saturated_sub_frames = frame.nb_saturated_sub_frames;
+    info.max_saturated_pixels = frame.max_saturated_pixels;
+    if (append)
+        history.append(frame.data, frame.stride, info);
+    else
+        history.push(frame.data, frame.stride, info);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_getHistoryFrame(const FrameHistory& history, int index, _RawFrame& frame)
+{
+    FrameHistory::Info info;
+    const FrameDim& frame_dim = history.getFrameDim();
+    frame.data = history.getFrame(index, info);
+    frame.stride = frame_dim.getSize().getWidth() * frame_dim.getDepth();
+    frame.type = frame_dim.getImageType();
+    frame.timestamp = info.timestamp;
+    frame.camera_timestamp = info.camera_timestamp;
+    frame.frame_counter = info.frame_counter;
+    frame.gpio_state = info.gpio_state;
+    frame.seq_step = info.seq_step;
+    frame.frame_nb = info.frame_nb;
+    frame.nb_saturated_sub_frames = info.nb_saturated_sub_frames;
+    frame.max_saturated_pixels = info.max_saturated_pixels;
+}
+
+//-----------------------------------------------------
+// Copy a frame into the frame buffer ring and publish it
+//-----------------------------------------------------
+bool Camera::_publishFrame(const _RawFrame& frame)
+{
+    DEB_MEMBER_FUNCT();
+    // the buffers past the requested frames still belong to Lima
+    if (_isAcqComplete())
+        return false;
+    StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj.getBuffer();
+
+    DEB_TRACE() << "image# " << m_image_number << " acquired";
+    FrameMetadata& metadata = m_frame_metadata[m_image_number % m_frame_metadata.size()];
+    metadata.acq_frame_nb = m_image_number;
+    metadata.seq_step = -1;
+    metadata.exp_time = metadata.gain = 0.;
+    metadata.timestamp = frame.timestamp;
+    metadata.camera_timestamp = frame.camera_timestamp;
+    metadata.frame_counter = frame.frame_counter;
+    metadata.gpio_state = frame.gpio_state;
+    metadata.raw_frame_nb = frame.frame_nb;
+    metadata.synced_timestamp = 0.;
+    if (frame.camera_timestamp > 0. &&
+        !m_clock_model.convert(frame.camera_timestamp, metadata.synced_timestamp))
+        metadata.synced_timestamp = 0.;
+    metadata.nb_sub_frames = m_accumulation_active ? m_accumulator.getNbSubFrames() : 1;
+    metadata.nb_saturated_sub_frames = frame.nb_saturated_sub_frames;
+    metadata.max_saturated_pixels = frame.max_saturated_pixels;
+
+    if (m_seq_active && !m_seq_steps.empty())
+    {
+        metadata.seq_step = frame.seq_step;
+        if (frame.seq_step >= 0)
+        {
+            const _SeqStep& step = m_seq_steps[frame.seq_step];
+            metadata.exp_time = step.exp_time;
+            metadata.gain = step.gain;
+        }
+    }
+
+    if (m_beam_active)
+    {
+        POINTGREY_TRACE(m_tracer, "beamAnalysis", m_image_number);
+        m_beam_analyzer.process(frame.data, frame.stride, m_image_number,
+                                metadata.timestamp, metadata.synced_timestamp);
+    }
+    if (m_roi_counters_active)
+    {
+        POINTGREY_TRACE(m_tracer, "roiCounters", m_image_number);
+        m_roi_counters.process(frame.data, frame.stride, m_image_number, metadata.timestamp);
+    }
+
+    if (m_recorder_active)
+    {
+        Recorder::IndexRecord record;
+        record.timestamp = frame.timestamp;
+        record.camera_timestamp = frame.camera_timestamp;
+        record.acq_frame_nb = m_image_number;
+        record.frame_counter = frame.frame_counter;
+        try
+        {
+            POINTGREY_TRACE(m_tracer, "record", m_image_number);
+            m_recorder.write(frame.data, frame.stride, record);
+        }
+        catch (Exception& e)
+        {
+            DEB_ERROR() << "Recorder failed: " << e.getErrDesc();
+            _setStatus(Camera::Fault, false);
+            return false;
+        }
+        m_image_number++;
+        _notifyEvent();
+        return true;
+    }
+
+    if (!m_frame_publish_active)
+    {
+        // only the analysis results are published
+        m_image_number++;
+        _notifyEvent();
+        return true;
+    }
+
+    void* framePt = buffer_mgr.getFrameBufferPtr(m_image_number);
+    // accumulated frames can already be in place
+    if (frame.data != framePt)
+    {
+        if (!_waitFrameUnpinned())
+            return false;
+        POINTGREY_TRACE(m_tracer, "copy", m_image_number);
+        if (m_correction_active)
+            m_correction.process(frame.data, frame.stride, frame.type, framePt);
+        else
+        {
+            const FrameDim& fDim = buffer_mgr.getFrameDim();
+            memcpy(framePt, frame.data, fDim.getMemSize());
+        }
+    }
+
+    if (m_defect_active || m_defect_map.isBuilding())
+    {
+        POINTGREY_TRACE(m_tracer, "defects", m_image_number);
+        m_defect_map.process(framePt, buffer_mgr.getFrameDim().getImageType());
+    }
+
+    if (m_compression_active)
+    {
+        POINTGREY_TRACE(m_tracer, "compress", m_image_number);
+        m_compressor.process(m_image_number, framePt);
+    }
+
+    bool continue_acq;
+    {
+        POINTGREY_TRACE(m_tracer, "publish", m_image_number);
+        HwFrameInfoType frame_info;
+        frame_info.acq_frame_nb = m_image_number;
+        continue_acq = buffer_mgr.newFrameReady(frame_info);
+    }
+    _updateGrabStats(metadata.synced_timestamp);
+
+    if (m_shm_active)
+    {
+        ShmPublisher::SlotHeader info;
+        info.acq_frame_nb = metadata.acq_frame_nb;
+        info.frame_counter = metadata.frame_counter;
+        info.gpio_state = metadata.gpio_state;
+        info.seq_step = metadata.seq_step;
+        info.timestamp = metadata.timestamp;
+        info.camera_timestamp = metadata.camera_timestamp;
+        info.synced_timestamp = metadata.synced_timestamp;
+        info.exp_time = metadata.exp_time;
+        info.gain = metadata.gain;
+        POINTGREY_TRACE(m_tracer, "shm", m_image_number);
+        m_shm_publisher.publish(framePt, info);
+    }
+
+    if (m_streamer.isRunning())
+    {
+        Streamer::Header info;
+        info.acq_frame_nb = metadata.acq_frame_nb;
+        info.frame_counter = metadata.frame_counter;
+        info.gpio_state = metadata.gpio_state;
+        info.seq_step = metadata.seq_step;
+        info.timestamp = metadata.timestamp;
+        info.camera_timestamp = metadata.camera_timestamp;
+        info.synced_timestamp = metadata.synced_timestamp;
+        info.exp_time = metadata.exp_time;
+        info.gain = metadata.gain;
+        POINTGREY_TRACE(m_tracer, "stream", m_image_number);
+        m_streamer.publish(framePt, buffer_mgr.getFrameDim(), info);
+    }
+    m_image_number++;
+    _notifyEvent();
+    return continue_acq;
+}
+
+//-----------------------------------------------------
+// called by the acquisition thread once the frame loop is over
+//-----------------------------------------------------
+void Camera::_finishAcq()
+{
+    DEB_MEMBER_FUNCT();
+    double elapsed = Timestamp::now() - m_grab_start_time;
+    double cpu_time = _getProcessCpuTime() - m_grab_start_cpu_time;
+    if (m_image_number)
+        m_grab_stats.frame_cpu_time = cpu_time / m_image_number;
+    m_grab_stats.cpu_load = (elapsed > 0) ? cpu_time / elapsed : 0.;
+
+    if (m_recorder.isOpen())
+    {
+        try
+        {
+            m_recorder.close();
+        }
+        catch (Exception& e)
+        {
+            DEB_ERROR() << e.getErrDesc();
+            _setStatus(Camera::Fault, false);
+        }
+    }
+}
+
+//-----------------------------------------------------
+// camera clock time of a frame, 0 when the camera provides none
+//-----------------------------------------------------
+double Camera::_getCameraTimestamp(const FlyCapture2::Image& image)
+{
+    FlyCapture2::TimeStamp ts = image.GetTimeStamp();
+    if (m_gige_camera)
+        return ts.seconds + ts.microSeconds * 1E-6;
+    if (!m_embedded_timestamp_active)
+        return 0.;
+
+    // 8000 cycles per second of 3072 ticks, unwrapped across the 128 s period
+    double cycle_time = ts.cycleSeconds + (ts.cycleCount + ts.cycleOffset / 3072.) / 8000.;
+    if (cycle_time < m_last_cycle_time - k_CycleTimerPeriod / 2)
+        m_cycle_time_base += k_CycleTimerPeriod;
+    m_last_cycle_time = cycle_time;
+    return m_cycle_time_base + cycle_time;
+}
+
+//-----------------------------------------------------
+// sequence step a frame was exposed with, -1 if unknown
+//-----------------------------------------------------
+int Camera::_getSeqStep(const FlyCapture2::Image *image, int frame_counter)
+{
+    if (!m_seq_active || m_seq_steps.empty())
+        return -1;
+
+    // the embedded settings hold whatever the pipeline delay and dropped frames
+    unsigned int nb_steps = m_seq_steps.size();
+    if (image && m_embedded_settings_active)
+    {
+        const FlyCapture2::ImageMetadata& metadata = image->GetMetadata();
+        unsigned int shutter = metadata.embeddedShutter & k_EmbeddedValueMask;
+        unsigned int gain = metadata.embeddedGain & k_EmbeddedValueMask;
+        for (unsigned int i = 0; i < nb_steps; ++i)
+            if (m_seq_steps[i].raw_shutter == shutter && m_seq_steps[i].raw_gain == gain)
+                return i;
+        // exposed before the first step reached the sensor
+        return -1;
+    }
+
+    // otherwise the steps advance once per exposed frame, the frame counter
+    // still counts the frames dropped on the way
+    if (frame_counter != -1)
+    {
+        if (!m_seq_counter_started)
+        {
+            m_seq_counter_origin = frame_counter;
+            m_seq_counter_started = true;
+        }
+        return (static_cast<unsigned int>(frame_counter) - m_seq_counter_origin) % nb_steps;
+    }
+    return m_raw_frame_nb % nb_steps;
+}
+
+//-----------------------------------------------------
+// embedded GPIO states, pin 0 is the most significant bit
+//-----------------------------------------------------
+int Camera::_getGpioState(const FlyCapture2::Image& image)
+{
+    unsigned int value = image.GetMetadata().embeddedGPIOPinState;
+    int state = 0;
+    for (int pin = 0; pin < k_NbGpioPins; ++pin)
+        if (value & (0x80000000u >> pin))
+            state |= 1 << pin;
+    return state;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+double Camera::_getProcessCpuTime()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return 0.;
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+            (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1E-6);
+}
+
+//-----------------------------------------------------
+// latency from the camera timestamp, once on the host clock, to publication
+//-----------------------------------------------------
+void Camera::_updateGrabStats(double synced_timestamp)
+{
+    if (!synced_timestamp)
+        return;
+    double latency = Timestamp::now() - synced_timestamp;
+    int nb_frames = ++m_grab_stats.nb_frames;
+    m_grab_stats.mean_latency += (latency - m_grab_stats.mean_latency) / nb_frames;
+    if (latency > m_grab_stats.max_latency)
+        m_grab_stats.max_latency = latency;
+}
+
 //-----------------------------------------------------
 // acquisition thread
 //-----------------------------------------------------
@@ -811,9 +4615,6 @@ Camera::_AcqThread::~_AcqThread()
 void Camera::_AcqThread::threadFunction()
 {
     DEB_MEMBER_FUNCT();
-    FlyCapture2::Error error;
-    FlyCapture2::Image image;
-
     sched_param param;
     param.sched_priority = sched_get_priority_max(SCHED_FIFO);
     if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
@@ -822,7 +4623,6 @@ void Camera::_AcqThread::threadFunction()
     }
 
     AutoMutex lock(m_cam.m_cond.mutex());
-    StdBufferCbMgr& buffer_mgr = m_cam.m_buffer_ctrl_obj.getBuffer();
 
     while (true)
     {
@@ -836,50 +4636,98 @@ void Camera::_AcqThread::threadFunction()
         if (m_cam.m_quit) return;
 
         m_cam.m_thread_running = true;
-        m_cam.m_status = Camera::Exposure;
         lock.unlock();
+        m_cam._setStatus(Camera::Exposure, true);
 
         DEB_TRACE() << "Run";
-        bool continue_acq = true;
+        // the backend is resolved once per acquisition, so that the grab
+        // loop is instantiated for the concrete camera class
+        if (m_cam.m_replay_active)
+            _replayLoop();
+        else if (m_cam.m_capture_mode == CaptureCallback)
+            _callbackLoop();
+        else if (m_cam.m_gige_camera)
+            _grabLoop(m_cam.m_gige_camera);
+        else
+            _grabLoop(m_cam.m_format7_camera);
+
+        m_cam._finishAcq();
+        m_cam.stopAcq();
+        lock.lock();
+    }
+}
 
-        continue_acq = true;
+//-----------------------------------------------------
+// qualified RetrieveBuffer call, statically bound to CameraType
+//-----------------------------------------------------
+template <class CameraType>
+void Camera::_AcqThread::_grabLoop(CameraType *camera)
+{
+    DEB_MEMBER_FUNCT();
+    FlyCapture2::Error error;
+    FlyCapture2::Image image;
+    bool continue_acq = true;
 
-        while (continue_acq && (!m_cam.m_nb_frames || m_cam.m_image_number < m_cam.m_nb_frames))
+    while (continue_acq && !m_cam._isAcqComplete())
+    {
         {
-            error = m_cam.m_camera->RetrieveBuffer(&image);
-            if (error == FlyCapture2::PGRERROR_OK)
-            {
-                // Grabbing was successful, process image
-                m_cam._setStatus(Camera::Readout, false);
-
-                DEB_TRACE() << "image# " << m_cam.m_image_number << " acquired";
-                void* framePt = buffer_mgr.getFrameBufferPtr(m_cam.m_image_number);
-                const FrameDim& fDim = buffer_mgr.getFrameDim();
-                memcpy(framePt, image.GetData(), fDim.getMemSize());
-
-                HwFrameInfoType frame_info;
-                frame_info.acq_frame_nb = m_cam.m_image_number;
-                continue_acq = buffer_mgr.newFrameReady(frame_info);
-                m_cam.m_image_number++;
-            }
-            else if (error == FlyCapture2::PGRERROR_ISOCH_NOT_STARTED)
-            {
-                DEB_TRACE() << "Acquisition aborted";
-                continue_acq = false;
-            }
-            else if (error == FlyCapture2::PGRERROR_IMAGE_CONSISTENCY_ERROR)
-            {
-                DEB_WARNING() << "No image acquired: " << error.GetDescription();
-            }
-            else
-            {
-                DEB_ERROR() << "No image acquired: " << error.GetDescription();
-                m_cam._setStatus(Camera::Fault, false);
-                continue_acq = false;
-            }
+            POINTGREY_TRACE(m_cam.m_tracer, "retrieve", m_cam.m_image_number);
+            error = camera->CameraType::RetrieveBuffer(&image);
+        }
+        if (error == FlyCapture2::PGRERROR_OK)
+        {
+            // Grabbing was successful, process image
+            m_cam._setStatus(Camera::Readout, false);
+            continue_acq = m_cam._processImage(image);
+        }
+        else if (error == FlyCapture2::PGRERROR_TIMEOUT)
+        {
+            // no frame within the grab timeout, e.g. waiting for a trigger
+            DEB_TRACE() << "No image within the grab timeout";
+            continue_acq = m_cam.m_acq_started;
+        }
+        else if (error == FlyCapture2::PGRERROR_ISOCH_NOT_STARTED)
+        {
+            DEB_TRACE() << "Acquisition aborted";
+            continue_acq = false;
+        }
+        else if (error == FlyCapture2::PGRERROR_IMAGE_CONSISTENCY_ERROR)
+        {
+            DEB_WARNING() << "No image acquired: " << error.GetDescription();
+        }
+        else
+        {
+            DEB_ERROR() << "No image acquired: " << error.GetDescription();
+            m_cam._setStatus(Camera::Fault, false);
+            continue_acq = false;
         }
-        m_cam.stopAcq();
-        lock.lock();
     }
 }
 
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_AcqThread::_replayLoop()
+{
+    DEB_MEMBER_FUNCT();
+    bool continue_acq = true;
+
+    while (continue_acq && !m_cam._isAcqComplete())
+        continue_acq = m_cam._processReplayFrame();
+}
+
+//-----------------------------------------------------
+// frames are processed by the driver callback, wait for its end
+//-----------------------------------------------------
+void Camera::_AcqThread::_callbackLoop()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_cam.m_cond.mutex());
+    while (m_cam.m_callback_active && m_cam.m_acq_started)
+        m_cam.m_cond.wait();
+    m_cam.m_callback_active = false;
+    // StopCapture() is only called later by stopAcq(), the frame in flight
+    // must be over before _finishAcq() closes what it uses
+    while (m_cam.m_nb_running_callbacks)
+        m_cam.m_cond.wait();
+}
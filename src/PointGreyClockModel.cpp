@@ -0,0 +1,263 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <math.h>
+#include "PointGreyClockModel.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+// the rate is only fitted once the samples span this camera time, s
+static const double k_MinRateSpan = 1.;
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+ClockModel::ClockModel()
+    : m_window(240)
+    , m_sample_interval(0.25)
+    , m_reset_threshold(0.5)
+    , m_frozen(false)
+    , m_nb_resets(0)
+    , m_snapshot_seq(0)
+{
+    _clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ClockModel::setWindow(int nb_samples)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_samples);
+    if (nb_samples < 2)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_samples);
+
+    AutoMutex lock(m_lock);
+    m_window = nb_samples;
+    _clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ClockModel::setSampleInterval(double interval)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(interval);
+    if (interval < 0)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(interval);
+
+    AutoMutex lock(m_lock);
+    m_sample_interval = interval;
+    _publish();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ClockModel::setResetThreshold(double threshold)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(threshold);
+    if (threshold <= 0)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(threshold);
+
+    AutoMutex lock(m_lock);
+    m_reset_threshold = threshold;
+    _publish();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ClockModel::reset()
+{
+    AutoMutex lock(m_lock);
+    _clear();
+    m_nb_resets = 0;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ClockModel::addSample(double camera_time, double host_time)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_frozen)
+        return;
+
+    // most frames fall between two samples and are on the line
+    _Snapshot snapshot;
+    _readSnapshot(snapshot);
+    if (snapshot.nb_samples &&
+        camera_time - snapshot.last_camera < snapshot.sample_interval &&
+        fabs(host_time - _predict(snapshot, camera_time)) <= snapshot.reset_threshold)
+        return;
+
+    AutoMutex lock(m_lock);
+    if (!m_samples.empty() &&
+        fabs(host_time - _predict(camera_time)) > m_reset_threshold)
+    {
+        DEB_TRACE() << "Clock model reset: " << DEB_VAR2(camera_time, host_time);
+        _clear();
+        ++m_nb_resets;
+    }
+
+    if (m_samples.empty())
+    {
+        m_camera_origin = camera_time;
+        m_host_origin = host_time;
+    }
+    else if (camera_time - m_last_camera < m_sample_interval)
+        return;
+
+    _Sample sample;
+    sample.camera = camera_time - m_camera_origin;
+    sample.host = host_time - m_host_origin;
+    if (int(m_samples.size()) < m_window)
+        m_samples.push_back(sample);
+    else
+        m_samples[m_next] = sample;
+    m_next = (m_next + 1) % m_window;
+    m_last_camera = camera_time;
+
+    _fit();
+    _publish();
+}
+
+//-----------------------------------------------------
+// lock-free, from the published snapshot
+//-----------------------------------------------------
+bool ClockModel::convert(double camera_time, double& host_time)
+{
+    _Snapshot snapshot;
+    _readSnapshot(snapshot);
+    if (!snapshot.nb_samples)
+        return false;
+    host_time = _predict(snapshot, camera_time);
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ClockModel::getStats(Stats& stats)
+{
+    AutoMutex lock(m_lock);
+    stats.nb_samples = m_samples.size();
+    stats.nb_resets = m_nb_resets;
+    stats.offset = m_samples.empty() ? 0. : _predict(m_last_camera) - m_last_camera;
+    stats.drift = (m_rate - 1.) * 1e6;
+    stats.jitter = m_jitter;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ClockModel::_clear()
+{
+    m_samples.clear();
+    m_samples.reserve(m_window);
+    m_next = 0;
+    m_camera_origin = m_host_origin = m_last_camera = 0.;
+    m_intercept = 0.;
+    m_rate = 1.;
+    m_jitter = 0.;
+    _publish();
+}
+
+//-----------------------------------------------------
+// called with the lock held
+//-----------------------------------------------------
+void ClockModel::_publish()
+{
+    unsigned long seq = m_snapshot_seq;
+    __atomic_store_n(&m_snapshot_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    m_snapshot.nb_samples = m_samples.size();
+    m_snapshot.camera_origin = m_camera_origin;
+    m_snapshot.host_origin = m_host_origin;
+    m_snapshot.intercept = m_intercept;
+    m_snapshot.rate = m_rate;
+    m_snapshot.last_camera = m_last_camera;
+    m_snapshot.sample_interval = m_sample_interval;
+    m_snapshot.reset_threshold = m_reset_threshold;
+    __atomic_store_n(&m_snapshot_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ClockModel::_readSnapshot(_Snapshot& snapshot) const
+{
+    while (true)
+    {
+        unsigned long seq = __atomic_load_n(&m_snapshot_seq, __ATOMIC_ACQUIRE);
+        if (seq % 2)
+            continue;
+        snapshot = m_snapshot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&m_snapshot_seq, __ATOMIC_RELAXED) == seq)
+            return;
+    }
+}
+
+//-----------------------------------------------------
+// centered least squares, the window is small enough to refit each sample
+//-----------------------------------------------------
+void ClockModel::_fit()
+{
+    int nb_samples = m_samples.size();
+    double mean_camera = 0., mean_host = 0.;
+    double min_camera = m_samples[0].camera, max_camera = min_camera;
+    for (int i = 0; i < nb_samples; ++i)
+    {
+        mean_camera += m_samples[i].camera;
+        mean_host += m_samples[i].host;
+        if (m_samples[i].camera < min_camera)
+            min_camera = m_samples[i].camera;
+        else if (m_samples[i].camera > max_camera)
+            max_camera = m_samples[i].camera;
+    }
+    mean_camera /= nb_samples;
+    mean_host /= nb_samples;
+
+    double sxx = 0., sxy = 0.;
+    for (int i = 0; i < nb_samples; ++i)
+    {
+        double dx = m_samples[i].camera - mean_camera;
+        sxx += dx * dx;
+        sxy += dx * (m_samples[i].host - mean_host);
+    }
+    // until the window spans enough time, only the offset is fitted
+    m_rate = (max_camera - min_camera >= k_MinRateSpan) ? sxy / sxx : 1.;
+    m_intercept = mean_host - m_rate * mean_camera;
+
+    double sum2 = 0.;
+    for (int i = 0; i < nb_samples; ++i)
+    {
+        double residual = m_samples[i].host - (m_intercept + m_rate * m_samples[i].camera);
+        sum2 += residual * residual;
+    }
+    m_jitter = sqrt(sum2 / nb_samples);
+}
@@ -0,0 +1,511 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <string.h>
+#include "lima/Timestamp.h"
+#include "PointGreyCompressor.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+static const int k_HeaderWords = 4;
+static const unsigned int k_StoredFlag = 0x80000000;
+
+static const int k_LZ4MinMatch = 4;
+static const int k_LZ4LastLiterals = 5;
+static const int k_LZ4MFLimit = 12;
+static const int k_LZ4MaxOffset = 65535;
+static const int k_LZ4HashLog = 12;  // log2 of Compressor::k_LZ4HashSize
+
+static inline unsigned int _read32(const unsigned char *p)
+{
+    unsigned int value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline unsigned int _hash(unsigned int sequence)
+{
+    return (sequence * 2654435761U) >> (32 - k_LZ4HashLog);
+}
+
+static inline unsigned char *_writeLength(unsigned char *op, int length)
+{
+    for (; length >= 255; length -= 255)
+        *op++ = 255;
+    *op++ = (unsigned char) length;
+    return op;
+}
+
+//-----------------------------------------------------
+// byte shuffle: gather byte b of every element together
+//-----------------------------------------------------
+static void _shuffle(const unsigned char *src, unsigned char *dst, int size, int element_size)
+{
+    int nb_elements = size / element_size;
+    for (int b = 0; b < element_size; ++b)
+    {
+        const unsigned char *s = src + b;
+        unsigned char *d = dst + b * nb_elements;
+        for (int i = 0; i < nb_elements; ++i, s += element_size)
+            d[i] = *s;
+    }
+}
+
+static void _unshuffle(const unsigned char *src, unsigned char *dst, int size, int element_size)
+{
+    int nb_elements = size / element_size;
+    for (int b = 0; b < element_size; ++b)
+    {
+        const unsigned char *s = src + b * nb_elements;
+        unsigned char *d = dst + b;
+        for (int i = 0; i < nb_elements; ++i, d += element_size)
+            *d = s[i];
+    }
+}
+
+//-----------------------------------------------------
+// greedy LZ4 block compressor, dst must hold lz4Bound(src_size)
+//-----------------------------------------------------
+int Compressor::lz4Compress(const unsigned char *src, int src_size,
+                            unsigned char *dst, unsigned int *hash_table)
+{
+    const unsigned char *ip = src;
+    const unsigned char *anchor = src;
+    const unsigned char *iend = src + src_size;
+    unsigned char *op = dst;
+
+    if (src_size > k_LZ4MFLimit)
+    {
+        const unsigned char *mflimit = iend - k_LZ4MFLimit;
+        const unsigned char *matchlimit = iend - k_LZ4LastLiterals;
+        int nb_misses = 0;
+        memset(hash_table, 0, sizeof(unsigned int) << k_LZ4HashLog);
+
+        while (ip < mflimit)
+        {
+            unsigned int sequence = _read32(ip);
+            unsigned int h = _hash(sequence);
+            const unsigned char *ref = src + hash_table[h];
+            hash_table[h] = ip - src;
+
+            if (ref >= ip || ip - ref > k_LZ4MaxOffset || _read32(ref) != sequence)
+            {
+                // skip faster through incompressible data
+                ip += (nb_misses++ >> 6) + 1;
+                continue;
+            }
+            nb_misses = 0;
+
+            const unsigned char *match_end = ip + k_LZ4MinMatch;
+            ref += k_LZ4MinMatch;
+            while (match_end < matchlimit && *match_end == *ref)
+                ++match_end, ++ref;
+
+            int literal_length = ip - anchor;
+            int match_length = match_end - ip - k_LZ4MinMatch;
+            int offset = match_end - ref;
+
+            unsigned char *token = op++;
+            *token = (literal_length >= 15 ? 15 : literal_length) << 4;
+            if (literal_length >= 15)
+                op = _writeLength(op, literal_length - 15);
+            memcpy(op, anchor, literal_length);
+            op += literal_length;
+
+            *op++ = offset & 0xff;
+            *op++ = offset >> 8;
+            *token |= (match_length >= 15 ? 15 : match_length);
+            if (match_length >= 15)
+                op = _writeLength(op, match_length - 15);
+
+            ip = anchor = match_end;
+        }
+    }
+
+    // last literals
+    int literal_length = iend - anchor;
+    *op++ = (literal_length >= 15 ? 15 : literal_length) << 4;
+    if (literal_length >= 15)
+        op = _writeLength(op, literal_length - 15);
+    memcpy(op, anchor, literal_length);
+    op += literal_length;
+
+    return op - dst;
+}
+
+//-----------------------------------------------------
+// returns the decompressed size or -1 on malformed input
+//-----------------------------------------------------
+int Compressor::lz4Decompress(const unsigned char *src, int src_size,
+                              unsigned char *dst, int dst_capacity)
+{
+    const unsigned char *ip = src;
+    const unsigned char *iend = src + src_size;
+    unsigned char *op = dst;
+    unsigned char *oend = dst + dst_capacity;
+
+    while (ip < iend)
+    {
+        unsigned int token = *ip++;
+        int literal_length = token >> 4;
+        if (literal_length == 15)
+        {
+            unsigned int b;
+            do
+            {
+                if (ip >= iend)
+                    return -1;
+                b = *ip++;
+                literal_length += b;
+            } while (b == 255);
+        }
+        if (literal_length > iend - ip || literal_length > oend - op)
+            return -1;
+        memcpy(op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+        if (ip >= iend)
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - dst)
+            return -1;
+
+        int match_length = token & 15;
+        if (match_length == 15)
+        {
+            unsigned int b;
+            do
+            {
+                if (ip >= iend)
+                    return -1;
+                b = *ip++;
+                match_length += b;
+            } while (b == 255);
+        }
+        match_length += k_LZ4MinMatch;
+        if (match_length > oend - op)
+            return -1;
+
+        // byte copy, the match may overlap the output
+        const unsigned char *ref = op - offset;
+        for (int i = 0; i < match_length; ++i)
+            op[i] = ref[i];
+        op += match_length;
+    }
+    return op - dst;
+}
+
+//-----------------------------------------------------
+// _Job class
+//-----------------------------------------------------
+class Compressor::_Job : public WorkerPool::Job
+{
+public:
+    _Job(Compressor& comp, const unsigned char *frame, unsigned char *slot)
+        : m_comp(comp), m_frame(frame), m_slot(slot)
+    {}
+
+    virtual void run(int part, int nb_parts)
+    {
+        unsigned int *header = (unsigned int *) m_slot;
+        unsigned char *staging = m_slot + (k_HeaderWords + m_comp.m_nb_chunks) * sizeof(unsigned int);
+        int chunk_bound = lz4Bound(m_comp.m_chunk_size);
+        int element_size = m_comp.m_element_size;
+        unsigned char *shuffled = &m_comp.m_shuffle[part][0];
+        unsigned int *hash_table = &m_comp.m_hash[part][0];
+
+        for (int c = part; c < m_comp.m_nb_chunks; c += nb_parts)
+        {
+            int offset = c * m_comp.m_chunk_size;
+            int size = m_comp.m_raw_size - offset;
+            if (size > m_comp.m_chunk_size)
+                size = m_comp.m_chunk_size;
+
+            const unsigned char *chunk = m_frame + offset;
+            if (element_size > 1)
+            {
+                _shuffle(chunk, shuffled, size, element_size);
+                chunk = shuffled;
+            }
+
+            unsigned char *out = staging + c * chunk_bound;
+            int out_size = lz4Compress(chunk, size, out, hash_table);
+            if (out_size >= size)
+            {
+                memcpy(out, m_frame + offset, size);
+                header[k_HeaderWords + c] = size | k_StoredFlag;
+            }
+            else
+                header[k_HeaderWords + c] = out_size;
+        }
+    }
+
+private:
+    Compressor& m_comp;
+    const unsigned char *m_frame;
+    unsigned char *m_slot;
+};
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Compressor::Compressor()
+    : m_chunk_size(256 * 1024)
+    , m_ring_size(16)
+    , m_raw_size(0)
+    , m_element_size(1)
+    , m_nb_chunks(0)
+    , m_slot_capacity(0)
+{
+    DEB_CONSTRUCTOR();
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Compressor::~Compressor()
+{
+    DEB_DESTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Compressor::setChunkSize(int chunk_size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(chunk_size);
+    if (chunk_size < 4096 || chunk_size % 16)
+        THROW_HW_ERROR(InvalidValue) << "Chunk size must be a multiple of 16 of at least 4096 bytes";
+    m_chunk_size = chunk_size;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Compressor::setRingSize(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (nb_frames < 1)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_frames);
+    m_ring_size = nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Compressor::prepare(const FrameDim& frame_dim)
+{
+    DEB_MEMBER_FUNCT();
+    m_raw_size = frame_dim.getMemSize();
+    m_element_size = frame_dim.getDepth();
+    m_nb_chunks = (m_raw_size + m_chunk_size - 1) / m_chunk_size;
+    m_slot_capacity = (k_HeaderWords + m_nb_chunks) * sizeof(unsigned int) +
+                      m_nb_chunks * lz4Bound(m_chunk_size);
+
+    m_ring.resize(size_t(m_slot_capacity) * m_ring_size);
+    _Slot empty = { 0, 0 };
+    m_slots.assign(m_ring_size, empty);
+
+    int nb_threads = getNbThreads();
+    m_shuffle.resize(nb_threads);
+    m_hash.resize(nb_threads);
+    for (int i = 0; i < nb_threads; ++i)
+    {
+        m_shuffle[i].resize(m_chunk_size);
+        m_hash[i].resize(k_LZ4HashSize);
+    }
+
+    AutoMutex lock(m_stats_lock);
+    memset(&m_stats, 0, sizeof(m_stats));
+    DEB_TRACE() << DEB_VAR3(m_raw_size, m_nb_chunks, m_slot_capacity);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Compressor::process(int acq_frame_nb, const void *frame)
+{
+    Timestamp t0 = Timestamp::now();
+    int slot_nb = acq_frame_nb % m_ring_size;
+    _Slot& slot = m_slots[slot_nb];
+    unsigned char *data = &m_ring[size_t(slot_nb) * m_slot_capacity];
+    // odd seq first, readers of the previous frame in this slot see it change
+    __atomic_store_n(&slot.seq, 2LL * acq_frame_nb + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    unsigned int *header = (unsigned int *) data;
+    header[0] = m_raw_size;
+    header[1] = m_element_size;
+    header[2] = m_nb_chunks;
+    header[3] = m_chunk_size;
+
+    _Job job(*this, (const unsigned char *) frame, data);
+    m_pool.run(job);
+
+    // pack the chunks behind each other
+    int chunk_bound = lz4Bound(m_chunk_size);
+    unsigned char *staging = data + (k_HeaderWords + m_nb_chunks) * sizeof(unsigned int);
+    unsigned char *out = staging;
+    for (int c = 0; c < m_nb_chunks; ++c)
+    {
+        int size = header[k_HeaderWords + c] & ~k_StoredFlag;
+        if (out != staging + c * chunk_bound)
+            memmove(out, staging + c * chunk_bound, size);
+        out += size;
+    }
+    int size = out - data;
+    slot.size = size;
+    __atomic_store_n(&slot.seq, 2LL * (acq_frame_nb + 1), __ATOMIC_RELEASE);
+
+    double elapsed = Timestamp::now() - t0;
+    AutoMutex lock(m_stats_lock);
+    ++m_stats.nb_frames;
+    m_stats.raw_bytes += m_raw_size;
+    m_stats.compressed_bytes += size;
+    m_stats.mean_time += (elapsed - m_stats.mean_time) / m_stats.nb_frames;
+    if (elapsed > m_stats.max_time)
+        m_stats.max_time = elapsed;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int Compressor::_getSlot(int acq_frame_nb, int& size)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_slots.empty() || acq_frame_nb < 0)
+        THROW_HW_ERROR(InvalidValue) << "Compressed frame not available: " << DEB_VAR1(acq_frame_nb);
+    int slot_nb = acq_frame_nb % m_ring_size;
+    const _Slot& slot = m_slots[slot_nb];
+    if (__atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE) != 2LL * (acq_frame_nb + 1))
+        THROW_HW_ERROR(InvalidValue) << "Compressed frame not available: " << DEB_VAR1(acq_frame_nb);
+    size = slot.size;
+    return slot_nb;
+}
+
+//-----------------------------------------------------
+// whether the slot still holds the frame after a copy
+//-----------------------------------------------------
+bool Compressor::_checkSlot(int slot_nb, int acq_frame_nb) const
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&m_slots[slot_nb].seq, __ATOMIC_RELAXED) == 2LL * (acq_frame_nb + 1);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Compressor::getFrame(int acq_frame_nb, std::string& data)
+{
+    DEB_MEMBER_FUNCT();
+    int size;
+    int slot_nb = _getSlot(acq_frame_nb, size);
+    const char *slot_data = (const char *) &m_ring[size_t(slot_nb) * m_slot_capacity];
+    data.assign(slot_data, size);
+
+    // the slot may have been reused during the copy
+    if (!_checkSlot(slot_nb, acq_frame_nb))
+        THROW_HW_ERROR(Error) << "Compressed frame overwritten: " << DEB_VAR1(acq_frame_nb);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int Compressor::getFrameSize(int acq_frame_nb)
+{
+    DEB_MEMBER_FUNCT();
+    int size;
+    int slot_nb = _getSlot(acq_frame_nb, size);
+    if (!_checkSlot(slot_nb, acq_frame_nb))
+        THROW_HW_ERROR(Error) << "Compressed frame overwritten: " << DEB_VAR1(acq_frame_nb);
+    return size;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Compressor::getStats(Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_stats_lock);
+    stats = m_stats;
+    stats.ratio = stats.compressed_bytes ? stats.raw_bytes / stats.compressed_bytes : 0.;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Compressor::decompress(const void *src, int src_size, std::string& raw)
+{
+    DEB_STATIC_FUNCT();
+    const unsigned int *header = (const unsigned int *) src;
+    if (src_size < int(k_HeaderWords * sizeof(unsigned int)))
+        THROW_HW_ERROR(InvalidValue) << "Truncated compressed frame";
+
+    int raw_size = header[0];
+    int element_size = header[1];
+    int nb_chunks = header[2];
+    int chunk_size = header[3];
+    int header_size = (k_HeaderWords + nb_chunks) * sizeof(unsigned int);
+    if (element_size < 1 || chunk_size < 1 || src_size < header_size ||
+        nb_chunks != (raw_size + chunk_size - 1) / chunk_size)
+        THROW_HW_ERROR(InvalidValue) << "Invalid compressed frame header";
+
+    raw.resize(raw_size);
+    std::vector<unsigned char> shuffled(chunk_size);
+    const unsigned char *ip = (const unsigned char *) src + header_size;
+    const unsigned char *iend = (const unsigned char *) src + src_size;
+    for (int c = 0; c < nb_chunks; ++c)
+    {
+        int size = header[k_HeaderWords + c] & ~k_StoredFlag;
+        bool stored = header[k_HeaderWords + c] & k_StoredFlag;
+        int offset = c * chunk_size;
+        int chunk_raw_size = (raw_size - offset < chunk_size) ? raw_size - offset : chunk_size;
+        unsigned char *out = (unsigned char *) &raw[offset];
+        if (size > iend - ip)
+            THROW_HW_ERROR(InvalidValue) << "Truncated compressed frame";
+
+        if (stored)
+        {
+            if (size != chunk_raw_size)
+                THROW_HW_ERROR(InvalidValue) << "Invalid stored chunk " << c;
+            memcpy(out, ip, size);
+        }
+        else
+        {
+            unsigned char *dst = (element_size > 1) ? &shuffled[0] : out;
+            if (lz4Decompress(ip, size, dst, chunk_raw_size) != chunk_raw_size)
+                THROW_HW_ERROR(InvalidValue) << "Corrupted chunk " << c;
+            if (element_size > 1)
+                _unshuffle(dst, out, chunk_raw_size, element_size);
+        }
+        ip += size;
+    }
+}
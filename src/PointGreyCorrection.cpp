@@ -0,0 +1,268 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "PointGreyCorrection.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+// row kernels
+//-----------------------------------------------------
+static inline void _store1(float *dst, float value)
+{
+    *dst = value;
+}
+
+static inline void _store1(unsigned short *dst, float value)
+{
+    value = value < 0.f ? 0.f : (value > 65535.f ? 65535.f : value);
+    *dst = (unsigned short) lrintf(value);
+}
+
+#ifdef __SSE2__
+static inline void _load8(const unsigned char *src, __m128& lo, __m128& hi)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) src), zero);
+    lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+    hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+}
+
+static inline void _load8(const unsigned short *src, __m128& lo, __m128& hi)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_loadu_si128((const __m128i *) src);
+    lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+    hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+}
+
+static inline void _store8(float *dst, __m128 lo, __m128 hi)
+{
+    _mm_storeu_ps(dst, lo);
+    _mm_storeu_ps(dst + 4, hi);
+}
+
+static inline void _store8(unsigned short *dst, __m128 lo, __m128 hi)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max_value = _mm_set1_ps(65535.f);
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(short(0x8000));
+
+    lo = _mm_min_ps(_mm_max_ps(lo, zero), max_value);
+    hi = _mm_min_ps(_mm_max_ps(hi, zero), max_value);
+    // SSE2 has no unsigned 32->16 pack: shift to the signed range and back
+    __m128i ilo = _mm_sub_epi32(_mm_cvtps_epi32(lo), bias32);
+    __m128i ihi = _mm_sub_epi32(_mm_cvtps_epi32(hi), bias32);
+    __m128i packed = _mm_add_epi16(_mm_packs_epi32(ilo, ihi), bias16);
+    _mm_storeu_si128((__m128i *) dst, packed);
+}
+#endif
+
+template <class SrcT, class DstT>
+static void _correctRow(const SrcT *src, const float *dark, const float *gain,
+                        DstT *dst, int width)
+{
+    int x = 0;
+#ifdef __SSE2__
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128 lo, hi;
+        _load8(src + x, lo, hi);
+        lo = _mm_mul_ps(_mm_sub_ps(lo, _mm_loadu_ps(dark + x)), _mm_loadu_ps(gain + x));
+        hi = _mm_mul_ps(_mm_sub_ps(hi, _mm_loadu_ps(dark + x + 4)), _mm_loadu_ps(gain + x + 4));
+        _store8(dst + x, lo, hi);
+    }
+#endif
+    for (; x < width; ++x)
+        _store1(dst + x, (float(src[x]) - dark[x]) * gain[x]);
+}
+
+template <class SrcT, class DstT>
+static void _correctRows(const void *src, int src_stride, const float *dark, const float *gain,
+                         void *dst, int width, int row_begin, int row_end)
+{
+    const char *src_row = (const char *) src + row_begin * src_stride;
+    DstT *dst_row = (DstT *) dst + row_begin * width;
+    for (int row = row_begin; row < row_end; ++row)
+    {
+        int offset = row * width;
+        _correctRow((const SrcT *) src_row, dark + offset, gain + offset, dst_row, width);
+        src_row += src_stride;
+        dst_row += width;
+    }
+}
+
+//-----------------------------------------------------
+// _Job class
+//-----------------------------------------------------
+class Correction::_Job : public WorkerPool::Job
+{
+public:
+    _Job(Correction& corr, const void *src, int src_stride, ImageType src_type, void *dst)
+        : m_corr(corr), m_src(src), m_src_stride(src_stride), m_src_type(src_type), m_dst(dst)
+    {}
+
+    virtual void run(int part, int nb_parts)
+    {
+        int width = m_corr.m_size.getWidth();
+        int height = m_corr.m_size.getHeight();
+        int row_begin = height * part / nb_parts;
+        int row_end = height * (part + 1) / nb_parts;
+        const float *dark = &m_corr.m_dark[0];
+        const float *gain = &m_corr.m_gain[0];
+        bool to_float = m_corr.m_output_type == Bpp32F;
+
+        if (m_src_type == Bpp8 && to_float)
+            _correctRows<unsigned char, float>(m_src, m_src_stride, dark, gain, m_dst,
+                                               width, row_begin, row_end);
+        else if (m_src_type == Bpp8)
+            _correctRows<unsigned char, unsigned short>(m_src, m_src_stride, dark, gain, m_dst,
+                                                        width, row_begin, row_end);
+        else if (to_float)
+            _correctRows<unsigned short, float>(m_src, m_src_stride, dark, gain, m_dst,
+                                                width, row_begin, row_end);
+        else
+            _correctRows<unsigned short, unsigned short>(m_src, m_src_stride, dark, gain, m_dst,
+                                                         width, row_begin, row_end);
+    }
+
+private:
+    Correction& m_corr;
+    const void *m_src;
+    int m_src_stride;
+    ImageType m_src_type;
+    void *m_dst;
+};
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Correction::Correction()
+    : m_output_type(Bpp32F)
+{
+    DEB_CONSTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Correction::~Correction()
+{
+    DEB_DESTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Correction::setDarkMap(const float *map, const Size& size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(size);
+    m_dark_map.assign(map, map + size.getWidth() * size.getHeight());
+    m_dark_size = size;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Correction::clearDarkMap()
+{
+    DEB_MEMBER_FUNCT();
+    m_dark_map.clear();
+    m_dark_size = Size();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Correction::setGainMap(const float *map, const Size& size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(size);
+    m_gain_map.assign(map, map + size.getWidth() * size.getHeight());
+    m_gain_size = size;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Correction::clearGainMap()
+{
+    DEB_MEMBER_FUNCT();
+    m_gain_map.clear();
+    m_gain_size = Size();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Correction::setOutputImageType(ImageType type)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(type);
+    if (type != Bpp32F && type != Bpp16)
+        THROW_HW_ERROR(InvalidValue) << "Correction output must be Bpp32F or Bpp16";
+    m_output_type = type;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Correction::prepare(const Size& size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(size);
+    int nb_pixels = size.getWidth() * size.getHeight();
+
+    if (m_dark_map.empty())
+        m_dark.assign(nb_pixels, 0.f);
+    else if (m_dark_size == size)
+        m_dark = m_dark_map;
+    else
+        THROW_HW_ERROR(Error) << "Dark map size " << m_dark_size
+                              << " does not match the frame size " << size;
+
+    if (m_gain_map.empty())
+        m_gain.assign(nb_pixels, 1.f);
+    else if (m_gain_size == size)
+        m_gain = m_gain_map;
+    else
+        THROW_HW_ERROR(Error) << "Gain map size " << m_gain_size
+                              << " does not match the frame size " << size;
+
+    m_size = size;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Correction::process(const void *src, int src_stride, ImageType src_type, void *dst)
+{
+    _Job job(*this, src, src_stride, src_type, dst);
+    m_pool.run(job);
+}
@@ -0,0 +1,304 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <algorithm>
+#include <math.h>
+#include "PointGreyDefectMap.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+template <class T>
+static inline T _fromDouble(double value)
+{
+    return T(value + 0.5);
+}
+
+template <>
+inline float _fromDouble<float>(double value)
+{
+    return float(value);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+DefectMap::DefectMap()
+    : m_mode(Median)
+    , m_build_nb_frames(0)
+    , m_build_done(false)
+    , m_build_count(0)
+    , m_build_nb_sigma(0.)
+{
+    DEB_CONSTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void DefectMap::clear()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_lock);
+    m_build_done = false;
+    m_pixels.clear();
+    m_index.clear();
+    m_neighbours.clear();
+    m_neighbour_begin.clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void DefectMap::addPixel(int x, int y)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(x, y);
+    if (x < 0 || y < 0)
+        THROW_HW_ERROR(InvalidValue) << "Invalid pixel " << DEB_VAR2(x, y);
+    AutoMutex lock(m_lock);
+    _finishBuild();
+    m_pixels.push_back(Point(x, y));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int DefectMap::getNbPixels()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_lock);
+    _finishBuild();
+    return m_pixels.size();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void DefectMap::setMask(const unsigned char *mask, const Size& size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(size);
+    clear();
+    AutoMutex lock(m_lock);
+    for (int y = 0; y < size.getHeight(); ++y)
+        for (int x = 0; x < size.getWidth(); ++x, ++mask)
+            if (*mask)
+                m_pixels.push_back(Point(x, y));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void DefectMap::startBuild(int nb_frames, double nb_sigma)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(nb_frames, nb_sigma);
+    if (nb_frames < 1 || nb_sigma <= 0.)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR2(nb_frames, nb_sigma);
+    AutoMutex lock(m_lock);
+    _finishBuild();
+    // started after prepare(), the frames come without another prepare()
+    m_build_sum.assign(m_size.getWidth() * m_size.getHeight(), 0.);
+    m_build_count = 0;
+    m_build_nb_sigma = nb_sigma;
+    m_build_nb_frames = nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void DefectMap::prepare(const Size& size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(size);
+    int width = size.getWidth();
+    int height = size.getHeight();
+    AutoMutex lock(m_lock);
+    _finishBuild();
+    m_size = size;
+
+    m_index.clear();
+    for (std::vector<Point>::const_iterator it = m_pixels.begin(); it != m_pixels.end(); ++it)
+        if (it->x < width && it->y < height)
+            m_index.push_back(it->y * width + it->x);
+    std::sort(m_index.begin(), m_index.end());
+    m_index.erase(std::unique(m_index.begin(), m_index.end()), m_index.end());
+
+    // neighbours which are neither outside the frame nor defective themselves
+    m_neighbours.clear();
+    m_neighbour_begin.clear();
+    for (std::vector<unsigned int>::const_iterator it = m_index.begin(); it != m_index.end(); ++it)
+    {
+        m_neighbour_begin.push_back(m_neighbours.size());
+        int x = *it % width;
+        int y = *it / width;
+        for (int ny = y - 1; ny <= y + 1; ++ny)
+            for (int nx = x - 1; nx <= x + 1; ++nx)
+            {
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height || (nx == x && ny == y))
+                    continue;
+                unsigned int n = ny * width + nx;
+                if (!std::binary_search(m_index.begin(), m_index.end(), n))
+                    m_neighbours.push_back(n);
+            }
+    }
+    m_neighbour_begin.push_back(m_neighbours.size());
+
+    if (isBuilding())
+    {
+        m_build_sum.assign(width * height, 0.);
+        m_build_count = 0;
+    }
+    DEB_TRACE() << m_index.size() << " defective pixels";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void DefectMap::process(void *frame, ImageType type)
+{
+    DEB_MEMBER_FUNCT();
+    switch (type)
+    {
+    case Bpp8:
+        if (isBuilding())
+            _accumulate((const unsigned char *) frame);
+        _correct((unsigned char *) frame);
+        break;
+    case Bpp16:
+        if (isBuilding())
+            _accumulate((const unsigned short *) frame);
+        _correct((unsigned short *) frame);
+        break;
+    case Bpp32:
+        if (isBuilding())
+            _accumulate((const unsigned int *) frame);
+        _correct((unsigned int *) frame);
+        break;
+    case Bpp32F:
+        if (isBuilding())
+            _accumulate((const float *) frame);
+        _correct((float *) frame);
+        break;
+    default:
+        THROW_HW_ERROR(NotSupported) << "Defect correction not supported for " << DEB_VAR1(type);
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+template <class T>
+void DefectMap::_correct(T *frame)
+{
+    T values[8];
+    int nb_defects = m_index.size();
+    for (int i = 0; i < nb_defects; ++i)
+    {
+        int nb_values = 0;
+        for (unsigned int n = m_neighbour_begin[i]; n < m_neighbour_begin[i + 1]; ++n)
+            values[nb_values++] = frame[m_neighbours[n]];
+        if (!nb_values)
+            continue;
+
+        if (m_mode == Mean)
+        {
+            double sum = 0.;
+            for (int v = 0; v < nb_values; ++v)
+                sum += values[v];
+            frame[m_index[i]] = _fromDouble<T>(sum / nb_values);
+        }
+        else
+        {
+            std::sort(values, values + nb_values);
+            int mid = nb_values / 2;
+            if (nb_values % 2)
+                frame[m_index[i]] = values[mid];
+            else
+                frame[m_index[i]] = _fromDouble<T>((double(values[mid - 1]) + values[mid]) / 2);
+        }
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+template <class T>
+void DefectMap::_accumulate(const T *frame)
+{
+    int nb_pixels = m_build_sum.size();
+    for (int i = 0; i < nb_pixels; ++i)
+        m_build_sum[i] += frame[i];
+    if (++m_build_count == m_build_nb_frames)
+    {
+        // the extraction would stall the frame loop, it is left to the next caller
+        m_build_nb_frames = 0;
+        m_build_done.store(true, __ATOMIC_RELEASE);
+    }
+}
+
+//-----------------------------------------------------
+// defects of a completed build, called with the lock held
+//-----------------------------------------------------
+void DefectMap::_finishBuild()
+{
+    DEB_MEMBER_FUNCT();
+    if (!m_build_done.exchange(false, __ATOMIC_ACQUIRE))
+        return;
+
+    int nb_pixels = m_build_sum.size();
+    if (!nb_pixels || !m_build_count)
+    {
+        DEB_ERROR() << "Defect map build without frames: " << DEB_VAR2(nb_pixels, m_build_count);
+        std::vector<double>().swap(m_build_sum);
+        return;
+    }
+
+    int width = m_size.getWidth();
+    std::vector<double>& mean = m_build_sum;
+    for (int i = 0; i < nb_pixels; ++i)
+        mean[i] /= m_build_count;
+
+    // robust estimate of the dark level and its spread: median and MAD
+    std::vector<double> work(mean);
+    std::nth_element(work.begin(), work.begin() + nb_pixels / 2, work.end());
+    double median = work[nb_pixels / 2];
+    for (int i = 0; i < nb_pixels; ++i)
+        work[i] = fabs(mean[i] - median);
+    std::nth_element(work.begin(), work.begin() + nb_pixels / 2, work.end());
+    double sigma = 1.4826 * work[nb_pixels / 2];
+    if (sigma <= 0.)
+        sigma = 1.;
+
+    int nb_found = 0;
+    double limit = m_build_nb_sigma * sigma;
+    for (int i = 0; i < nb_pixels; ++i)
+        if (fabs(mean[i] - median) > limit)
+        {
+            m_pixels.push_back(Point(i % width, i / width));
+            ++nb_found;
+        }
+    DEB_TRACE() << "Defect map built: " << DEB_VAR3(median, sigma, nb_found);
+
+    std::vector<double>().swap(m_build_sum);
+}
@@ -0,0 +1,135 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <string.h>
+#include "PointGreyFrameHistory.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+FrameHistory::FrameHistory()
+    : m_capacity(0),
+      m_frame_size(0),
+      m_nb_slots(0),
+      m_first(0),
+      m_nb_frames(0)
+{
+    DEB_CONSTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+FrameHistory::~FrameHistory()
+{
+    DEB_DESTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameHistory::setCapacity(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (nb_frames < 0)
+        THROW_HW_ERROR(InvalidValue) << "Invalid history capacity: " << DEB_VAR1(nb_frames);
+    m_capacity = nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameHistory::prepare(const FrameDim& frame_dim)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(frame_dim, m_capacity);
+    m_frame_dim = frame_dim;
+    m_frame_size = frame_dim.getMemSize();
+    m_nb_slots = m_capacity + 1;
+    m_data.resize((size_t) m_nb_slots * m_frame_size);
+    m_infos.resize(m_nb_slots);
+    m_first = 0;
+    m_nb_frames = 0;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameHistory::push(const void *src, int src_stride, const Info& info)
+{
+    if (!m_capacity)
+        return;
+
+    _copy((m_first + m_nb_frames) % m_nb_slots, src, src_stride, info);
+    if (m_nb_frames < m_capacity)
+        ++m_nb_frames;
+    else
+        m_first = (m_first + 1) % m_nb_slots;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameHistory::append(const void *src, int src_stride, const Info& info)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_nb_frames == m_nb_slots)
+        THROW_HW_ERROR(Error) << "Frame history overflow";
+    _copy((m_first + m_nb_frames) % m_nb_slots, src, src_stride, info);
+    ++m_nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameHistory::_copy(int slot, const void *src, int src_stride, const Info& info)
+{
+    char *dst = &m_data[(size_t) slot * m_frame_size];
+    int row_size = m_frame_dim.getSize().getWidth() * m_frame_dim.getDepth();
+    if (src_stride == row_size)
+        memcpy(dst, src, m_frame_size);
+    else
+    {
+        const char *src_row = (const char *) src;
+        for (int row = 0; row < m_frame_dim.getSize().getHeight(); ++row)
+        {
+            memcpy(dst, src_row, row_size);
+            dst += row_size;
+            src_row += src_stride;
+        }
+    }
+    m_infos[slot] = info;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+const void *FrameHistory::getFrame(int index, Info& info) const
+{
+    int slot = (m_first + index) % m_nb_slots;
+    info = m_infos[slot];
+    return &m_data[(size_t) slot * m_frame_size];
+}
@@ -0,0 +1,207 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include "PointGreyFrameSelector.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+FrameSelector::FrameSelector()
+    : m_criterion(MaxAbove),
+      m_threshold(0.),
+      m_nb_pre_frames(0),
+      m_nb_post_frames(0),
+      m_type(Bpp16),
+      m_x0(0), m_y0(0), m_width(0), m_height(0),
+      m_previous_sum(0.),
+      m_has_previous(false),
+      m_post_left(0)
+{
+    DEB_CONSTRUCTOR();
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+FrameSelector::~FrameSelector()
+{
+    DEB_DESTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameSelector::setNbPreFrames(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (nb_frames < 0)
+        THROW_HW_ERROR(InvalidValue) << "Invalid number of pre frames: " << DEB_VAR1(nb_frames);
+    m_nb_pre_frames = nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameSelector::setNbPostFrames(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (nb_frames < 0)
+        THROW_HW_ERROR(InvalidValue) << "Invalid number of post frames: " << DEB_VAR1(nb_frames);
+    m_nb_post_frames = nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameSelector::prepare(const Size& size, ImageType type)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(size, type);
+    if (type != Bpp8 && type != Bpp16 && type != Bpp32)
+        THROW_HW_ERROR(NotSupported) << "Frame selection not supported for " << DEB_VAR1(type);
+
+    if (m_region.isEmpty())
+    {
+        m_x0 = m_y0 = 0;
+        m_width = size.getWidth();
+        m_height = size.getHeight();
+    }
+    else
+    {
+        m_x0 = m_region.getTopLeft().x;
+        m_y0 = m_region.getTopLeft().y;
+        m_width = m_region.getSize().getWidth();
+        m_height = m_region.getSize().getHeight();
+        if (m_x0 < 0 || m_y0 < 0 || m_x0 + m_width > size.getWidth() ||
+            m_y0 + m_height > size.getHeight())
+            THROW_HW_ERROR(Error) << "Selection region " << m_region
+                                  << " outside of the frame " << size;
+    }
+
+    m_type = type;
+    m_has_previous = false;
+    m_post_left = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+template <class SrcT>
+void FrameSelector::_measure(const void *src, int src_stride, double& sum, double& max_value)
+{
+    unsigned long long total = 0;
+    unsigned int max_pixel = 0;
+    const char *src_row = (const char *) src + m_y0 * src_stride;
+    for (int row = 0; row < m_height; ++row, src_row += src_stride)
+    {
+        const SrcT *pixel = (const SrcT *) src_row + m_x0;
+        unsigned int row_max = 0;
+        unsigned long long row_sum = 0;
+        for (int x = 0; x < m_width; ++x)
+        {
+            unsigned int value = pixel[x];
+            row_sum += value;
+            row_max = (value > row_max) ? value : row_max;
+        }
+        total += row_sum;
+        max_pixel = (row_max > max_pixel) ? row_max : max_pixel;
+    }
+    sum = double(total);
+    max_value = max_pixel;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool FrameSelector::select(const void *src, int src_stride)
+{
+    double sum, max_value;
+    switch (m_type)
+    {
+    case Bpp8:
+        _measure<unsigned char>(src, src_stride, sum, max_value);
+        break;
+    case Bpp16:
+        _measure<unsigned short>(src, src_stride, sum, max_value);
+        break;
+    default:
+        _measure<unsigned int>(src, src_stride, sum, max_value);
+    }
+
+    bool fired;
+    switch (m_criterion)
+    {
+    case MaxAbove:
+        fired = max_value >= m_threshold;
+        m_stats.last_value = max_value;
+        break;
+    case SumAbove:
+        fired = sum >= m_threshold;
+        m_stats.last_value = sum;
+        break;
+    default:
+        {
+            // the first frame has no reference; a dark reference is taken as one
+            // count per pixel, otherwise any change after it would fire
+            double reference = std::max(m_previous_sum, double(m_width) * m_height);
+            fired = m_has_previous && fabs(sum - m_previous_sum) >= m_threshold * reference;
+            m_stats.last_value = sum;
+        }
+    }
+    m_previous_sum = sum;
+    m_has_previous = true;
+
+    ++m_stats.nb_frames;
+    bool selected = fired || m_post_left > 0;
+    if (fired)
+    {
+        ++m_stats.nb_triggers;
+        m_post_left = m_nb_post_frames;
+    }
+    else if (selected)
+        --m_post_left;
+
+    if (selected)
+        ++m_stats.nb_selected;
+    else
+        ++m_stats.nb_rejected;
+    return selected;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameSelector::getStats(Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    stats = m_stats;
+}
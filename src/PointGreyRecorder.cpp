@@ -0,0 +1,412 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lima/Timestamp.h"
+#include "PointGreyRecorder.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+// _Writer class
+//-----------------------------------------------------
+class Recorder::_Writer : public Thread
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Recorder", "_Writer");
+public:
+    _Writer(Recorder& rec) : m_rec(rec) {}
+    virtual ~_Writer() { join(); }
+protected:
+    virtual void threadFunction();
+private:
+    Recorder& m_rec;
+};
+
+void Recorder::_Writer::threadFunction()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_rec.m_cond.mutex());
+
+    while (true)
+    {
+        while (m_rec.m_queue.empty() && !m_rec.m_quit)
+            m_rec.m_cond.wait();
+        if (m_rec.m_queue.empty())
+            return;
+
+        int buffer_nb = m_rec.m_queue.front();
+        m_rec.m_queue.erase(m_rec.m_queue.begin());
+        _Buffer& buffer = m_rec.m_buffers[buffer_nb];
+        lock.unlock();
+
+        bool ok = !m_rec.m_failed;
+        if (ok && buffer.nb_frames)
+        {
+            size_t size = size_t(buffer.nb_frames) * m_rec.m_header.frame_stride;
+            off_t offset = buffer.records.front().offset;
+            size_t written = 0;
+            while (ok && written < size)
+            {
+                ssize_t n = pwrite(m_rec.m_fd, buffer.data + written, size - written, offset + written);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                {
+                    DEB_ERROR() << "Failed to write sequence file: " << strerror(errno);
+                    ok = false;
+                }
+                else
+                    written += n;
+            }
+            if (ok && fwrite(&buffer.records[0], sizeof(IndexRecord), buffer.nb_frames,
+                             m_rec.m_idx_file) != size_t(buffer.nb_frames))
+            {
+                DEB_ERROR() << "Failed to write index file: " << strerror(errno);
+                ok = false;
+            }
+        }
+
+        lock.lock();
+        if (ok)
+            m_rec.m_stats.nb_bytes += double(buffer.nb_frames) * m_rec.m_header.frame_stride;
+        else
+            m_rec.m_failed = true;
+        buffer.nb_frames = 0;
+        buffer.records.clear();
+        buffer.busy = false;
+        m_rec.m_cond.broadcast();
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Recorder::Recorder()
+    : m_nb_buffers(2)
+    , m_buffer_size(16)
+    , m_fd(-1)
+    , m_idx_file(NULL)
+    , m_direct_io(false)
+    , m_fill(0)
+    , m_writer(NULL)
+    , m_quit(false)
+    , m_failed(false)
+    , m_nb_frames(0)
+    , m_start_time(0.)
+{
+    DEB_CONSTRUCTOR();
+    memset(&m_header, 0, sizeof(m_header));
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Recorder::~Recorder()
+{
+    DEB_DESTRUCTOR();
+    if (isOpen())
+    {
+        try
+        {
+            close();
+        }
+        catch (Exception&)
+        {
+        }
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Recorder::setFileName(const std::string& file_name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(file_name);
+    m_file_name = file_name;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Recorder::setNbBuffers(int nb_buffers)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_buffers);
+    if (nb_buffers < 2)
+        THROW_HW_ERROR(InvalidValue) << "At least 2 buffers are needed";
+    m_nb_buffers = nb_buffers;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Recorder::setBufferSize(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (nb_frames < 1)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_frames);
+    m_buffer_size = nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Recorder::open(const FrameDim& frame_dim)
+{
+    DEB_MEMBER_FUNCT();
+    if (isOpen())
+        close();
+    if (m_file_name.empty())
+        THROW_HW_ERROR(Error) << "No recorder file name";
+
+    m_frame_dim = frame_dim;
+    memset(&m_header, 0, sizeof(m_header));
+    memcpy(m_header.magic, "PGRYSEQ1", sizeof(m_header.magic));
+    m_header.version = 1;
+    m_header.width = frame_dim.getSize().getWidth();
+    m_header.height = frame_dim.getSize().getHeight();
+    m_header.image_type = frame_dim.getImageType();
+    m_header.frame_size = frame_dim.getMemSize();
+    m_header.frame_stride = (m_header.frame_size + k_Align - 1) / k_Align * k_Align;
+    m_header.header_size = (sizeof(SeqHeader) + k_Align - 1) / k_Align * k_Align;
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    m_fd = ::open(m_file_name.c_str(), flags | O_DIRECT, 0644);
+    m_direct_io = (m_fd >= 0);
+    if (!m_direct_io)
+        // file system without O_DIRECT support, e.g. tmpfs
+        m_fd = ::open(m_file_name.c_str(), flags, 0644);
+    if (m_fd < 0)
+        THROW_HW_ERROR(Error) << "Failed to open " << m_file_name << ": " << strerror(errno);
+
+    std::string idx_name = m_file_name + ".idx";
+    m_idx_file = fopen(idx_name.c_str(), "wb");
+    if (!m_idx_file)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        THROW_HW_ERROR(Error) << "Failed to open " << idx_name << ": " << strerror(errno);
+    }
+    IdxHeader idx_header;
+    memset(&idx_header, 0, sizeof(idx_header));
+    memcpy(idx_header.magic, "PGRYIDX1", sizeof(idx_header.magic));
+    idx_header.version = 1;
+    idx_header.record_size = sizeof(IndexRecord);
+    fwrite(&idx_header, sizeof(idx_header), 1, m_idx_file);
+
+    m_buffers.resize(m_nb_buffers);
+    size_t buffer_bytes = size_t(m_buffer_size) * m_header.frame_stride;
+    bool allocated = true;
+    for (int i = 0; i < m_nb_buffers; ++i)
+    {
+        _Buffer& buffer = m_buffers[i];
+        void *ptr = NULL;
+        if (allocated && posix_memalign(&ptr, k_Align, buffer_bytes))
+        {
+            ptr = NULL;
+            allocated = false;
+        }
+        buffer.data = (char *) ptr;
+        buffer.nb_frames = 0;
+        buffer.records.reserve(m_buffer_size);
+        buffer.busy = false;
+    }
+
+    try
+    {
+        if (!allocated)
+            THROW_HW_ERROR(Error) << "Failed to allocate recorder buffers";
+        _writeHeader();
+    }
+    catch (Exception&)
+    {
+        _freeBuffers();
+        fclose(m_idx_file);
+        m_idx_file = NULL;
+        ::close(m_fd);
+        m_fd = -1;
+        throw;
+    }
+
+    m_queue.clear();
+    m_queue.reserve(m_nb_buffers);
+    m_fill = 0;
+    m_quit = false;
+    m_failed = false;
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.direct_io = m_direct_io;
+    m_nb_frames = 0;
+    m_start_time = Timestamp::now();
+
+    m_writer = new _Writer(*this);
+    m_writer->start();
+    DEB_TRACE() << "Recording to " << m_file_name << DEB_VAR1(m_direct_io);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Recorder::write(const void *frame, int stride, const IndexRecord& record)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_failed)
+        THROW_HW_ERROR(Error) << "Recorder failed to write to disk";
+
+    _Buffer& buffer = m_buffers[m_fill];
+    char *dst = buffer.data + size_t(buffer.nb_frames) * m_header.frame_stride;
+    int row_size = m_header.frame_size / m_header.height;
+    if (stride == row_size)
+        memcpy(dst, frame, m_header.frame_size);
+    else
+    {
+        const char *src = (const char *) frame;
+        for (int row = 0; row < m_header.height; ++row, src += stride, dst += row_size)
+            memcpy(dst, src, row_size);
+    }
+
+    int nb_frames = m_nb_frames.load(__ATOMIC_RELAXED);
+    IndexRecord rec = record;
+    rec.offset = m_header.header_size + (long long) nb_frames * m_header.frame_stride;
+    buffer.records.push_back(rec);
+    m_nb_frames.store(nb_frames + 1, __ATOMIC_RELEASE);
+
+    if (++buffer.nb_frames == m_buffer_size)
+        _submit();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Recorder::_submit()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_cond.mutex());
+    m_buffers[m_fill].busy = true;
+    m_queue.push_back(m_fill);
+    m_cond.broadcast();
+
+    m_fill = (m_fill + 1) % m_nb_buffers;
+    if (m_buffers[m_fill].busy)
+    {
+        ++m_stats.nb_waits;
+        while (m_buffers[m_fill].busy && !m_failed)
+            m_cond.wait();
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Recorder::close()
+{
+    DEB_MEMBER_FUNCT();
+    if (!isOpen())
+        return;
+
+    if (m_buffers[m_fill].nb_frames)
+        _submit();
+
+    AutoMutex lock(m_cond.mutex());
+    m_quit = true;
+    m_cond.broadcast();
+    lock.unlock();
+    delete m_writer;
+    m_writer = NULL;
+
+    double elapsed = Timestamp::now() - m_start_time;
+    lock.lock();
+    m_stats.nb_frames = m_nb_frames;
+    m_stats.write_rate = elapsed > 0 ? m_stats.nb_bytes / elapsed / 1e6 : 0.;
+    lock.unlock();
+
+    m_header.nb_frames = m_stats.nb_frames;
+    bool failed = m_failed;
+    try
+    {
+        _writeHeader();
+    }
+    catch (Exception&)
+    {
+        failed = true;
+    }
+
+    fclose(m_idx_file);
+    m_idx_file = NULL;
+    ::close(m_fd);
+    m_fd = -1;
+    _freeBuffers();
+
+    DEB_TRACE() << "Recorded " << m_stats.nb_frames << " frames at " << m_stats.write_rate << " MB/s";
+    if (failed)
+        THROW_HW_ERROR(Error) << "Recording to " << m_file_name << " is incomplete";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Recorder::getStats(Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_cond.mutex());
+    stats = m_stats;
+    stats.nb_frames = m_nb_frames;
+    if (isOpen())
+    {
+        double elapsed = Timestamp::now() - m_start_time;
+        stats.write_rate = elapsed > 0 ? stats.nb_bytes / elapsed / 1e6 : 0.;
+    }
+}
+
+//-----------------------------------------------------
+// the header block is aligned for O_DIRECT too
+//-----------------------------------------------------
+void Recorder::_writeHeader()
+{
+    DEB_MEMBER_FUNCT();
+    void *block;
+    if (posix_memalign(&block, k_Align, m_header.header_size))
+        THROW_HW_ERROR(Error) << "Failed to allocate recorder header";
+    memset(block, 0, m_header.header_size);
+    memcpy(block, &m_header, sizeof(m_header));
+    ssize_t n = pwrite(m_fd, block, m_header.header_size, 0);
+    free(block);
+    if (n != m_header.header_size)
+        THROW_HW_ERROR(Error) << "Failed to write sequence header: " << strerror(errno);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Recorder::_freeBuffers()
+{
+    for (std::vector<_Buffer>::iterator it = m_buffers.begin(); it != m_buffers.end(); ++it)
+        free(it->data);
+    m_buffers.clear();
+}
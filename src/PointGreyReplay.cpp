@@ -0,0 +1,253 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lima/SizeUtils.h"
+#include "lima/Timestamp.h"
+#include "PointGreyReplay.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Replay::Replay()
+    : m_data(NULL)
+    , m_size(0)
+    , m_pacing(Recorded)
+    , m_frame_rate(100.)
+    , m_loop(false)
+    , m_next(0)
+    , m_nb_served(0)
+    , m_start_time(0.)
+    , m_aborted(false)
+{
+    DEB_CONSTRUCTOR();
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Replay::~Replay()
+{
+    DEB_DESTRUCTOR();
+    close();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Replay::open(const std::string& file_name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(file_name);
+    close();
+
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+        THROW_HW_ERROR(Error) << "Failed to open " << file_name << ": " << strerror(errno);
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(Recorder::SeqHeader))
+    {
+        ::close(fd);
+        THROW_HW_ERROR(Error) << file_name << " is not a sequence file";
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        THROW_HW_ERROR(Error) << "Failed to map " << file_name << ": " << strerror(errno);
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    Recorder::SeqHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "PGRYSEQ1", sizeof(header.magic)) || header.frame_size <= 0 ||
+        header.frame_stride < header.frame_size || header.width <= 0 || header.height <= 0)
+    {
+        munmap(data, st.st_size);
+        THROW_HW_ERROR(Error) << file_name << " is not a sequence file";
+    }
+    // frames are published as width x height of image_type, never read past them
+    ImageType image_type = ImageType(header.image_type);
+    if ((image_type != Bpp8 && image_type != Bpp16) ||
+        header.frame_size != FrameDim(header.width, header.height, image_type).getMemSize() ||
+        header.header_size < int(sizeof(header)) || header.header_size > st.st_size)
+    {
+        munmap(data, st.st_size);
+        THROW_HW_ERROR(Error) << file_name << " has an inconsistent header: "
+                              << DEB_VAR4(header.width, header.height, header.image_type, header.frame_size);
+    }
+
+    // a recording which was not closed has no frame count, use the file size
+    long long nb_frames = (st.st_size - header.header_size) / header.frame_stride;
+    if (header.nb_frames > 0 && header.nb_frames < nb_frames)
+        nb_frames = header.nb_frames;
+
+    std::vector<Recorder::IndexRecord> records;
+    std::string idx_name = file_name + ".idx";
+    FILE *idx_file = fopen(idx_name.c_str(), "rb");
+    if (idx_file)
+    {
+        Recorder::IdxHeader idx_header;
+        Recorder::IndexRecord record;
+        if (fread(&idx_header, sizeof(idx_header), 1, idx_file) == 1 &&
+            !memcmp(idx_header.magic, "PGRYIDX1", sizeof(idx_header.magic)) &&
+            idx_header.record_size == sizeof(record))
+        {
+            while (fread(&record, sizeof(record), 1, idx_file) == 1 &&
+                   record.offset >= header.header_size &&
+                   record.offset + header.frame_size <= st.st_size)
+                records.push_back(record);
+        }
+        fclose(idx_file);
+    }
+    if (records.empty())
+    {
+        DEB_WARNING() << "No index for " << file_name << ", timestamps are not available";
+        for (long long i = 0; i < nb_frames; ++i)
+        {
+            Recorder::IndexRecord record;
+            record.offset = header.header_size + i * header.frame_stride;
+            record.timestamp = record.camera_timestamp = 0.;
+            record.acq_frame_nb = i;
+            record.frame_counter = -1;
+            records.push_back(record);
+        }
+    }
+    if (records.empty())
+    {
+        munmap(data, st.st_size);
+        THROW_HW_ERROR(Error) << file_name << " holds no frame";
+    }
+
+    m_file_name = file_name;
+    m_header = header;
+    m_records.swap(records);
+    m_data = (char *) data;
+    m_size = st.st_size;
+    DEB_TRACE() << "Replaying " << m_records.size() << " frames from " << m_file_name;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Replay::close()
+{
+    DEB_MEMBER_FUNCT();
+    if (!m_data)
+        return;
+    munmap(m_data, m_size);
+    m_data = NULL;
+    m_size = 0;
+    m_records.clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+FrameDim Replay::getFrameDim() const
+{
+    return FrameDim(Size(m_header.width, m_header.height), ImageType(m_header.image_type));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Replay::setFrameRate(double frame_rate)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(frame_rate);
+    if (frame_rate <= 0.)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(frame_rate);
+    m_frame_rate = frame_rate;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Replay::start()
+{
+    DEB_MEMBER_FUNCT();
+    m_next = 0;
+    m_nb_served = 0;
+    m_aborted = false;
+    m_start_time = Timestamp::now();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Replay::abort()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_cond.mutex());
+    m_aborted = true;
+    m_cond.broadcast();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool Replay::next(const void *& frame, Recorder::IndexRecord& record)
+{
+    DEB_MEMBER_FUNCT();
+    if (m_next == int(m_records.size()))
+    {
+        if (!m_loop)
+            return false;
+        // the recorded timing restarts with each pass
+        m_next = 0;
+        if (m_pacing == Recorded)
+            m_start_time = Timestamp::now();
+    }
+    record = m_records[m_next];
+
+    double due = m_start_time;
+    if (m_pacing == Recorded)
+        due += record.timestamp - m_records.front().timestamp;
+    else if (m_pacing == FixedRate)
+        due += m_nb_served / m_frame_rate;
+
+    if (m_pacing != AsFastAsPossible)
+    {
+        AutoMutex lock(m_cond.mutex());
+        double now;
+        while (!m_aborted && (now = Timestamp::now()) < due)
+            m_cond.wait(due - now);
+    }
+    if (m_aborted)
+        return false;
+
+    frame = m_data + record.offset;
+    ++m_next;
+    ++m_nb_served;
+    return true;
+}
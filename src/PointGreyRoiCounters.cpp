@@ -0,0 +1,312 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <string.h>
+#include "lima/Timestamp.h"
+#include "PointGreyRoiCounters.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+RoiCounters::RoiCounters()
+    : m_series_size(4096),
+      m_type(Bpp16),
+      m_record_size(k_NbHeaderFields),
+      m_write_count(0)
+{
+    DEB_CONSTRUCTOR();
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+RoiCounters::~RoiCounters()
+{
+    DEB_DESTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void RoiCounters::clear()
+{
+    DEB_MEMBER_FUNCT();
+    m_rois.clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int RoiCounters::add(const Roi& roi)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(roi);
+    if (roi.isEmpty())
+        THROW_HW_ERROR(InvalidValue) << "Empty counter region";
+    m_rois.push_back(roi);
+    return m_rois.size() - 1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+const Roi& RoiCounters::getRoi(int index) const
+{
+    DEB_MEMBER_FUNCT();
+    if (index < 0 || index >= getNbRois())
+        THROW_HW_ERROR(InvalidValue) << "Invalid counter region: " << DEB_VAR1(index);
+    return m_rois[index];
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void RoiCounters::setSeriesSize(int nb_records)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_records);
+    if (nb_records < 1)
+        THROW_HW_ERROR(InvalidValue) << "Series size must be at least 1";
+    m_series_size = nb_records;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void RoiCounters::prepare(const Size& size, ImageType type)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(size, type);
+    if (type != Bpp8 && type != Bpp16 && type != Bpp32)
+        THROW_HW_ERROR(NotSupported) << "Counters not supported for " << DEB_VAR1(type);
+
+    int width = size.getWidth();
+    int height = size.getHeight();
+    int nb_rois = getNbRois();
+    m_rects.resize(nb_rois);
+    for (int i = 0; i < nb_rois; ++i)
+    {
+        const Roi& roi = m_rois[i];
+        _Rect& rect = m_rects[i];
+        rect.x0 = roi.getTopLeft().x;
+        rect.y0 = roi.getTopLeft().y;
+        rect.x1 = rect.x0 + roi.getSize().getWidth();
+        rect.y1 = rect.y0 + roi.getSize().getHeight();
+        if (rect.x0 < 0 || rect.y0 < 0 || rect.x1 > width || rect.y1 > height)
+            THROW_HW_ERROR(Error) << "Counter region " << roi << " outside of the frame " << size;
+    }
+
+    m_row_begin.assign(height + 1, 0);
+    m_row_rois.clear();
+    m_row_x0.assign(height, width);
+    m_row_x1.assign(height, 0);
+    for (int y = 0; y < height; ++y)
+    {
+        m_row_begin[y] = m_row_rois.size();
+        for (int i = 0; i < nb_rois; ++i)
+        {
+            const _Rect& rect = m_rects[i];
+            if (y < rect.y0 || y >= rect.y1)
+                continue;
+            m_row_rois.push_back(i);
+            if (rect.x0 < m_row_x0[y])
+                m_row_x0[y] = rect.x0;
+            if (rect.x1 > m_row_x1[y])
+                m_row_x1[y] = rect.x1;
+        }
+    }
+    m_row_begin[height] = m_row_rois.size();
+    m_prefix.resize(width + 1);
+
+    m_sums.resize(nb_rois);
+    m_mins.resize(nb_rois);
+    m_maxs.resize(nb_rois);
+
+    m_size = size;
+    m_type = type;
+    m_record_size = k_NbHeaderFields + k_NbRoiFields * nb_rois;
+    // zero seq marks the slots empty
+    m_seqs.assign(m_series_size, 0);
+    m_records.assign((size_t) m_series_size * m_record_size, 0.);
+    __atomic_store_n(&m_write_count, 0, __ATOMIC_RELEASE);
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+template <class SrcT>
+void RoiCounters::_process(const void *src, int src_stride)
+{
+    int nb_rois = getNbRois();
+    for (int i = 0; i < nb_rois; ++i)
+    {
+        m_sums[i] = 0;
+        m_mins[i] = ~0u;
+        m_maxs[i] = 0;
+    }
+
+    long long *prefix = &m_prefix[0];
+    int height = m_size.getHeight();
+    for (int y = 0; y < height; ++y)
+    {
+        int begin = m_row_begin[y], end = m_row_begin[y + 1];
+        if (begin == end)
+            continue;
+
+        const SrcT *row = (const SrcT *) ((const char *) src + y * src_stride);
+        int span_x0 = m_row_x0[y], span_x1 = m_row_x1[y];
+        // prefix[x - span_x0] is the sum of row[span_x0..x[
+        long long sum = 0;
+        prefix[0] = 0;
+        for (int x = span_x0; x < span_x1; ++x)
+        {
+            sum += row[x];
+            prefix[x - span_x0 + 1] = sum;
+        }
+
+        for (int k = begin; k < end; ++k)
+        {
+            int i = m_row_rois[k];
+            const _Rect& rect = m_rects[i];
+            m_sums[i] += prefix[rect.x1 - span_x0] - prefix[rect.x0 - span_x0];
+
+            unsigned int min_value = m_mins[i], max_value = m_maxs[i];
+            for (int x = rect.x0; x < rect.x1; ++x)
+            {
+                unsigned int value = row[x];
+                min_value = (value < min_value) ? value : min_value;
+                max_value = (value > max_value) ? value : max_value;
+            }
+            m_mins[i] = min_value;
+            m_maxs[i] = max_value;
+        }
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void RoiCounters::process(const void *src, int src_stride, int acq_frame_nb, double timestamp)
+{
+    double start = Timestamp::now();
+    switch (m_type)
+    {
+    case Bpp8:
+        _process<unsigned char>(src, src_stride);
+        break;
+    case Bpp16:
+        _process<unsigned short>(src, src_stride);
+        break;
+    default:
+        _process<unsigned int>(src, src_stride);
+    }
+
+    long long index = m_write_count;
+    int slot = index % m_seqs.size();
+    double *record = &m_records[(size_t) slot * m_record_size];
+    __atomic_store_n(&m_seqs[slot], 2 * index + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record[0] = acq_frame_nb;
+    record[1] = timestamp;
+    double *counter = record + k_NbHeaderFields;
+    for (int i = 0; i < getNbRois(); ++i, counter += k_NbRoiFields)
+    {
+        const _Rect& rect = m_rects[i];
+        double area = double(rect.x1 - rect.x0) * (rect.y1 - rect.y0);
+        counter[0] = double(m_sums[i]);
+        counter[1] = counter[0] / area;
+        counter[2] = m_mins[i];
+        counter[3] = m_maxs[i];
+    }
+    __atomic_store_n(&m_seqs[slot], 2 * (index + 1), __ATOMIC_RELEASE);
+    __atomic_store_n(&m_write_count, index + 1, __ATOMIC_RELEASE);
+
+    double elapsed = Timestamp::now() - start;
+    m_stats.mean_time += (elapsed - m_stats.mean_time) / ++m_stats.nb_frames;
+    if (elapsed > m_stats.max_time)
+        m_stats.max_time = elapsed;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+long long RoiCounters::getWriteCount() const
+{
+    return __atomic_load_n(&m_write_count, __ATOMIC_ACQUIRE);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool RoiCounters::getRecord(long long index, double *record) const
+{
+    if (index < 0 || m_seqs.empty())
+        return false;
+    int slot = index % m_seqs.size();
+    long long seq = 2 * (index + 1);
+    if (__atomic_load_n(&m_seqs[slot], __ATOMIC_ACQUIRE) != seq)
+        return false;
+    memcpy(record, &m_records[(size_t) slot * m_record_size], m_record_size * sizeof(double));
+    // the copy is only consistent if seq did not move
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&m_seqs[slot], __ATOMIC_RELAXED) == seq;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void RoiCounters::getSeries(long long first, int max_nb, std::string& data) const
+{
+    long long count = getWriteCount();
+    long long oldest = count - (long long) m_seqs.size();
+    if (first < oldest)
+        first = oldest;
+    if (first < 0)
+        first = 0;
+    long long end = first + max_nb;
+    if (end > count)
+        end = count;
+
+    data.clear();
+    if (end <= first)
+        return;
+    std::vector<double> record(m_record_size);
+    data.reserve((end - first) * m_record_size * sizeof(double));
+    for (long long index = first; index < end; ++index)
+        // overwritten while reading, skipped
+        if (getRecord(index, &record[0]))
+            data.append((const char *) &record[0], m_record_size * sizeof(double));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void RoiCounters::getStats(Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    stats = m_stats;
+}
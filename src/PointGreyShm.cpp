@@ -0,0 +1,357 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lima/Timestamp.h"
+#include "PointGreyShm.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+static inline size_t _align(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+ShmPublisher::ShmPublisher()
+    : m_nb_slots(16)
+    , m_header(NULL)
+    , m_data(NULL)
+    , m_size(0)
+{
+    DEB_CONSTRUCTOR();
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+ShmPublisher::~ShmPublisher()
+{
+    DEB_DESTRUCTOR();
+    close();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ShmPublisher::setName(const std::string& name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(name);
+    if (name.size() < 2 || name[0] != '/' || name.find('/', 1) != std::string::npos)
+        THROW_HW_ERROR(InvalidValue) << "Shared memory name must be /name: " << DEB_VAR1(name);
+    m_name = name;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ShmPublisher::setNbSlots(int nb_slots)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_slots);
+    if (nb_slots < 2)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_slots);
+    m_nb_slots = nb_slots;
+}
+
+//-----------------------------------------------------
+// readers of a replaced segment see it closed and attach again
+//-----------------------------------------------------
+void ShmPublisher::prepare(const FrameDim& frame_dim)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(frame_dim);
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    int frame_size = frame_dim.getMemSize();
+    if (isOpen() && m_open_name == m_name &&
+        m_header->nb_slots == m_nb_slots &&
+        m_header->width == frame_dim.getSize().getWidth() &&
+        m_header->height == frame_dim.getSize().getHeight() &&
+        m_header->image_type == frame_dim.getImageType())
+        return;
+
+    close();
+    if (m_name.empty())
+        THROW_HW_ERROR(Error) << "No shared memory name";
+
+    size_t header_size = _align(sizeof(Header), k_Align);
+    size_t slot_size = _align(k_SlotHeaderSize + frame_size, 64);
+    size_t size = header_size + slot_size * m_nb_slots;
+
+    // a segment of another publisher, or left by a crashed one, is never unlinked
+    // here: its readers would be cut off without notice
+    int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno == EEXIST)
+        THROW_HW_ERROR(Error) << m_name << " already exists, used by another publisher "
+                              << "or left by a crashed one (remove /dev/shm" << m_name << ")";
+    if (fd < 0)
+        THROW_HW_ERROR(Error) << "Failed to create " << m_name << ": " << strerror(errno);
+    if (ftruncate(fd, size))
+    {
+        int err = errno;
+        ::close(fd);
+        shm_unlink(m_name.c_str());
+        THROW_HW_ERROR(Error) << "Failed to size " << m_name << ": " << strerror(err);
+    }
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+    {
+        shm_unlink(m_name.c_str());
+        THROW_HW_ERROR(Error) << "Failed to map " << m_name << ": " << strerror(errno);
+    }
+
+    m_header = (Header *) ptr;
+    m_data = (char *) ptr + header_size;
+    m_size = size;
+    m_open_name = m_name;
+
+    // ftruncate zero-fills, so every slot seq starts at 0
+    memcpy(m_header->magic, "PGRYSHM1", sizeof(m_header->magic));
+    m_header->version = 1;
+    m_header->header_size = header_size;
+    m_header->slot_size = slot_size;
+    m_header->nb_slots = m_nb_slots;
+    m_header->width = frame_dim.getSize().getWidth();
+    m_header->height = frame_dim.getSize().getHeight();
+    m_header->image_type = frame_dim.getImageType();
+    m_header->depth = frame_dim.getDepth();
+    m_header->frame_size = frame_size;
+    __atomic_store_n(&m_header->write_count, 0, __ATOMIC_RELEASE);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ShmPublisher::publish(const void *frame, const SlotHeader& info)
+{
+    double start = Timestamp::now();
+    long long frame_index = m_header->write_count;
+    SlotHeader *slot = (SlotHeader *)(m_data + (frame_index % m_nb_slots) * m_header->slot_size);
+
+    // odd seq first, readers of the previous frame in this slot see it change
+    __atomic_store_n(&slot->seq, 2 * frame_index + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->frame_index = frame_index;
+    slot->acq_frame_nb = info.acq_frame_nb;
+    slot->frame_counter = info.frame_counter;
+    slot->gpio_state = info.gpio_state;
+    slot->seq_step = info.seq_step;
+    slot->timestamp = info.timestamp;
+    slot->camera_timestamp = info.camera_timestamp;
+    slot->synced_timestamp = info.synced_timestamp;
+    slot->exp_time = info.exp_time;
+    slot->gain = info.gain;
+    memcpy((char *) slot + k_SlotHeaderSize, frame, m_header->frame_size);
+
+    __atomic_store_n(&slot->seq, 2 * (frame_index + 1), __ATOMIC_RELEASE);
+    __atomic_store_n(&m_header->write_count, frame_index + 1, __ATOMIC_RELEASE);
+
+    double elapsed = Timestamp::now() - start;
+    int nb_frames = ++m_stats.nb_frames;
+    m_stats.nb_bytes += m_header->frame_size;
+    m_stats.mean_time += (elapsed - m_stats.mean_time) / nb_frames;
+    if (elapsed > m_stats.max_time)
+        m_stats.max_time = elapsed;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ShmPublisher::close()
+{
+    if (!isOpen())
+        return;
+    __atomic_store_n(&m_header->closed, 1, __ATOMIC_RELEASE);
+    shm_unlink(m_open_name.c_str());
+    _unmap();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ShmPublisher::getStats(Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    stats = m_stats;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ShmPublisher::_unmap()
+{
+    munmap(m_header, m_size);
+    m_header = NULL;
+    m_data = NULL;
+    m_size = 0;
+    m_open_name.clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+ShmReader::ShmReader()
+    : m_header(NULL)
+    , m_size(0)
+{
+    DEB_CONSTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+ShmReader::~ShmReader()
+{
+    DEB_DESTRUCTOR();
+    detach();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ShmReader::attach(const std::string& name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(name);
+    detach();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        THROW_HW_ERROR(Error) << "Failed to open " << name << ": " << strerror(errno);
+    struct stat st;
+    if (fstat(fd, &st) || size_t(st.st_size) < sizeof(ShmPublisher::Header))
+    {
+        ::close(fd);
+        THROW_HW_ERROR(Error) << "Invalid shared memory segment " << name;
+    }
+    void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+        THROW_HW_ERROR(Error) << "Failed to map " << name << ": " << strerror(errno);
+
+    const ShmPublisher::Header *header = (const ShmPublisher::Header *) ptr;
+    if (memcmp(header->magic, "PGRYSHM1", sizeof(header->magic)) ||
+        size_t(header->header_size) + size_t(header->slot_size) * header->nb_slots > size_t(st.st_size))
+    {
+        munmap(ptr, st.st_size);
+        THROW_HW_ERROR(Error) << "Not a frame ring: " << name;
+    }
+    m_header = header;
+    m_size = st.st_size;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ShmReader::detach()
+{
+    if (!isAttached())
+        return;
+    munmap((void *) m_header, m_size);
+    m_header = NULL;
+    m_size = 0;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool ShmReader::isClosed() const
+{
+    return __atomic_load_n(&m_header->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+FrameDim ShmReader::getFrameDim() const
+{
+    return FrameDim(m_header->width, m_header->height, ImageType(m_header->image_type));
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+long long ShmReader::getWriteCount() const
+{
+    return __atomic_load_n(&m_header->write_count, __ATOMIC_ACQUIRE);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool ShmReader::getFrame(long long frame_index, const void *& data,
+                         ShmPublisher::SlotHeader& info) const
+{
+    const ShmPublisher::SlotHeader *slot = _getSlot(frame_index);
+    long long seq = 2 * (frame_index + 1);
+    if (frame_index < 0 || __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq)
+        return false;
+
+    info = *slot;
+    data = (const char *) slot + ShmPublisher::k_SlotHeaderSize;
+    // the slot header copy is only consistent if seq did not move
+    return isValid(frame_index);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool ShmReader::isValid(long long frame_index) const
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&_getSlot(frame_index)->seq, __ATOMIC_RELAXED) == 2 * (frame_index + 1);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool ShmReader::copyFrame(long long frame_index, void *buffer,
+                          ShmPublisher::SlotHeader& info) const
+{
+    const void *data;
+    if (!getFrame(frame_index, data, info))
+        return false;
+    memcpy(buffer, data, m_header->frame_size);
+    return isValid(frame_index);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+const ShmPublisher::SlotHeader *ShmReader::_getSlot(long long frame_index) const
+{
+    long long slot_nb = (frame_index < 0) ? 0 : frame_index % m_header->nb_slots;
+    return (const ShmPublisher::SlotHeader *)
+        ((const char *) m_header + m_header->header_size + slot_nb * m_header->slot_size);
+}
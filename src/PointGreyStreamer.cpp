@@ -0,0 +1,537 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "lima/Timestamp.h"
+#include "PointGreyCompressor.h"
+#include "PointGreyStreamer.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+// frame shared by the client queues
+//-----------------------------------------------------
+struct Streamer::_Message
+{
+    Header header;
+    std::vector<char> raw;
+    // compressed once, by the first client which sends it
+    Mutex lock;
+    std::vector<unsigned char> compressed;
+    int compressed_size;        // -1 until compressed, 0 if not smaller
+    Atomic<int> refs;
+};
+
+//-----------------------------------------------------
+// _Listener class
+//-----------------------------------------------------
+class Streamer::_Listener : public Thread
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Streamer", "_Listener");
+public:
+    _Listener(Streamer& streamer) : m_streamer(streamer) {}
+    virtual ~_Listener() { join(); }
+protected:
+    virtual void threadFunction();
+private:
+    Streamer& m_streamer;
+};
+
+void Streamer::_Listener::threadFunction()
+{
+    DEB_MEMBER_FUNCT();
+    while (true)
+    {
+        struct pollfd fds[2];
+        fds[0].fd = m_streamer.m_listen_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = m_streamer.m_wake_fds[0];
+        fds[1].events = POLLIN;
+        // the timeout bounds the delay to reap disconnected clients
+        int n = poll(fds, 2, 200);
+        if (n < 0 && errno != EINTR)
+        {
+            DEB_ERROR() << "Stream server poll failed: " << strerror(errno);
+            return;
+        }
+        if (n > 0 && fds[1].revents)
+            return;
+
+        if (n > 0 && (fds[0].revents & POLLIN))
+        {
+            struct sockaddr_in addr;
+            socklen_t addr_len = sizeof(addr);
+            int fd = accept(m_streamer.m_listen_fd, (struct sockaddr *) &addr, &addr_len);
+            if (fd >= 0)
+            {
+                char host[INET_ADDRSTRLEN] = "";
+                inet_ntop(AF_INET, &addr.sin_addr, host, sizeof(host));
+                char address[INET_ADDRSTRLEN + 8];
+                snprintf(address, sizeof(address), "%s:%d", host, ntohs(addr.sin_port));
+                m_streamer._addClient(fd, address);
+            }
+        }
+        m_streamer._reapClients(false);
+    }
+}
+
+//-----------------------------------------------------
+// _Client class
+//-----------------------------------------------------
+class Streamer::_Client : public Thread
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Streamer", "_Client");
+public:
+    _Client(Streamer& streamer, int fd, const std::string& address);
+    virtual ~_Client();
+
+    // queue a frame, dropping the oldest one if the queue is full
+    void push(_Message *msg);
+    bool isDead() const { return m_dead; }
+    void getStats(ClientStats& stats);
+protected:
+    virtual void threadFunction();
+private:
+    bool _send(const void *data, size_t size);
+    int _getPayload(_Message *msg, const void *& payload);
+
+    Streamer& m_streamer;
+    int m_fd;
+    Cond m_cond;
+    std::deque<_Message *> m_queue;
+    bool m_quit;
+    Atomic<bool> m_dead;
+    ClientStats m_stats;
+    double m_start_time;
+    std::vector<unsigned int> m_hash;
+};
+
+Streamer::_Client::_Client(Streamer& streamer, int fd, const std::string& address)
+    : m_streamer(streamer)
+    , m_fd(fd)
+    , m_quit(false)
+    , m_dead(false)
+    , m_start_time(Timestamp::now())
+    , m_hash(Compressor::k_LZ4HashSize)
+{
+    m_stats.address = address;
+    m_stats.queue_depth = 0;
+    m_stats.nb_sent = 0;
+    m_stats.nb_dropped = 0;
+    m_stats.nb_bytes = 0.;
+    m_stats.bandwidth = 0.;
+}
+
+Streamer::_Client::~_Client()
+{
+    AutoMutex lock(m_cond.mutex());
+    m_quit = true;
+    m_cond.broadcast();
+    lock.unlock();
+
+    // unblocks a send to a stalled client
+    shutdown(m_fd, SHUT_RDWR);
+    join();
+    close(m_fd);
+
+    for (std::deque<_Message *>::iterator i = m_queue.begin(); i != m_queue.end(); ++i)
+        m_streamer._releaseMessage(*i);
+}
+
+void Streamer::_Client::push(_Message *msg)
+{
+    AutoMutex lock(m_cond.mutex());
+    if (m_dead)
+        return;
+    if (int(m_queue.size()) >= m_streamer.m_queue_depth)
+    {
+        m_streamer._releaseMessage(m_queue.front());
+        m_queue.pop_front();
+        ++m_stats.nb_dropped;
+    }
+    ++msg->refs;
+    m_queue.push_back(msg);
+    m_cond.signal();
+}
+
+void Streamer::_Client::getStats(ClientStats& stats)
+{
+    AutoMutex lock(m_cond.mutex());
+    stats = m_stats;
+    stats.queue_depth = m_queue.size();
+    double elapsed = Timestamp::now() - m_start_time;
+    stats.bandwidth = (elapsed > 0) ? stats.nb_bytes / elapsed / 1e6 : 0.;
+}
+
+void Streamer::_Client::threadFunction()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_cond.mutex());
+
+    while (true)
+    {
+        while (m_queue.empty() && !m_quit)
+            m_cond.wait();
+        if (m_quit)
+            return;
+
+        _Message *msg = m_queue.front();
+        m_queue.pop_front();
+        Header header = msg->header;
+        header.nb_dropped = m_stats.nb_dropped;
+        lock.unlock();
+
+        const void *payload;
+        header.payload_size = _getPayload(msg, payload);
+        header.compressed = (payload != &msg->raw[0]);
+        bool ok = _send(&header, sizeof(header)) && _send(payload, header.payload_size);
+        m_streamer._releaseMessage(msg);
+
+        lock.lock();
+        if (!ok)
+        {
+            DEB_TRACE() << "Stream client " << m_stats.address << " disconnected";
+            m_dead = true;
+            return;
+        }
+        ++m_stats.nb_sent;
+        m_stats.nb_bytes += sizeof(header) + header.payload_size;
+    }
+}
+
+bool Streamer::_Client::_send(const void *data, size_t size)
+{
+    const char *ptr = (const char *) data;
+    while (size)
+    {
+        ssize_t n = send(m_fd, ptr, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+int Streamer::_Client::_getPayload(_Message *msg, const void *& payload)
+{
+    payload = &msg->raw[0];
+    if (!m_streamer.m_compression)
+        return msg->header.raw_size;
+
+    AutoMutex lock(msg->lock);
+    if (msg->compressed_size < 0)
+    {
+        int raw_size = msg->header.raw_size;
+        msg->compressed.resize(Compressor::lz4Bound(raw_size));
+        int size = Compressor::lz4Compress((const unsigned char *) &msg->raw[0], raw_size,
+                                           &msg->compressed[0], &m_hash[0]);
+        msg->compressed_size = (size < raw_size) ? size : 0;
+    }
+    if (!msg->compressed_size)
+        return msg->header.raw_size;
+    payload = &msg->compressed[0];
+    return msg->compressed_size;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Streamer::Streamer()
+    : m_port(0)
+    , m_bound_port(0)
+    , m_decimation(1)
+    , m_compression(false)
+    , m_queue_depth(4)
+    , m_max_clients(8)
+    , m_listen_fd(-1)
+    , m_listener(NULL)
+    , m_nb_clients(0)
+    , m_frame_count(0)
+{
+    DEB_CONSTRUCTOR();
+    m_wake_fds[0] = m_wake_fds[1] = -1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Streamer::~Streamer()
+{
+    DEB_DESTRUCTOR();
+    stop();
+    for (std::vector<_Message *>::iterator i = m_pool.begin(); i != m_pool.end(); ++i)
+        delete *i;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Streamer::setPort(int port)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(port);
+    if (port < 0 || port > 65535)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(port);
+    m_port = port;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Streamer::setDecimation(int decimation)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(decimation);
+    if (decimation < 1)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(decimation);
+    m_decimation = decimation;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Streamer::setQueueDepth(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if (nb_frames < 1)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_frames);
+    m_queue_depth = nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Streamer::setMaxClients(int nb_clients)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_clients);
+    if (nb_clients < 1)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_clients);
+    m_max_clients = nb_clients;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Streamer::start()
+{
+    DEB_MEMBER_FUNCT();
+    if (isRunning())
+        return;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        THROW_HW_ERROR(Error) << "Failed to create stream socket: " << strerror(errno);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(m_port);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+        listen(fd, 8) ||
+        getsockname(fd, (struct sockaddr *) &addr, &addr_len))
+    {
+        int err = errno;
+        close(fd);
+        THROW_HW_ERROR(Error) << "Failed to listen on port " << m_port << ": " << strerror(err);
+    }
+    if (pipe(m_wake_fds))
+    {
+        int err = errno;
+        close(fd);
+        THROW_HW_ERROR(Error) << "Failed to create stream wake-up pipe: " << strerror(err);
+    }
+
+    m_bound_port = ntohs(addr.sin_port);
+    m_listen_fd = fd;
+    m_frame_count = 0;
+    m_listener = new _Listener(*this);
+    m_listener->start();
+    DEB_TRACE() << "Streaming on port " << m_bound_port;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Streamer::stop()
+{
+    DEB_MEMBER_FUNCT();
+    if (!isRunning())
+        return;
+
+    if (write(m_wake_fds[1], "q", 1) != 1)
+        DEB_ERROR() << "Failed to wake the stream server up";
+    delete m_listener;
+    m_listener = NULL;
+
+    close(m_listen_fd);
+    close(m_wake_fds[0]);
+    close(m_wake_fds[1]);
+    m_listen_fd = m_wake_fds[0] = m_wake_fds[1] = -1;
+    m_bound_port = 0;
+
+    _reapClients(true);
+}
+
+//-----------------------------------------------------
+// one copy of the frame, shared by the client queues
+//-----------------------------------------------------
+void Streamer::publish(const void *frame, const FrameDim& frame_dim, const Header& info)
+{
+    if (!m_nb_clients)
+        return;
+    if (m_frame_count++ % m_decimation)
+        return;
+
+    _Message *msg = _getMessage();
+    Header& header = msg->header;
+    header = info;
+    memcpy(header.magic, "PGST", sizeof(header.magic));
+    header.version = 1;
+    header.header_size = sizeof(Header);
+    header.width = frame_dim.getSize().getWidth();
+    header.height = frame_dim.getSize().getHeight();
+    header.image_type = frame_dim.getImageType();
+    header.depth = frame_dim.getDepth();
+    header.raw_size = frame_dim.getMemSize();
+    header.compressed = header.payload_size = header.nb_dropped = header.reserved = 0;
+
+    msg->raw.resize(header.raw_size);
+    memcpy(&msg->raw[0], frame, header.raw_size);
+    msg->compressed_size = -1;
+    msg->refs = 1;
+
+    AutoMutex lock(m_lock);
+    for (std::vector<_Client *>::iterator i = m_clients.begin(); i != m_clients.end(); ++i)
+        (*i)->push(msg);
+    lock.unlock();
+    _releaseMessage(msg);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int Streamer::getNbClients()
+{
+    // disconnected clients are listed until the next reap
+    AutoMutex lock(m_lock);
+    return m_clients.size();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Streamer::getClientStats(int client, ClientStats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_lock);
+    if (client < 0 || client >= int(m_clients.size()))
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(client);
+    m_clients[client]->getStats(stats);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Streamer::_Message *Streamer::_getMessage()
+{
+    AutoMutex lock(m_pool_lock);
+    if (m_pool.empty())
+        return new _Message;
+    _Message *msg = m_pool.back();
+    m_pool.pop_back();
+    return msg;
+}
+
+//-----------------------------------------------------
+// keep enough messages for every queue, plus the one being published
+//-----------------------------------------------------
+void Streamer::_releaseMessage(_Message *msg)
+{
+    if (--msg->refs)
+        return;
+    AutoMutex lock(m_pool_lock);
+    if (int(m_pool.size()) < m_max_clients * (m_queue_depth + 1) + 1)
+        m_pool.push_back(msg);
+    else
+        delete msg;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Streamer::_addClient(int fd, const std::string& address)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_lock);
+    if (int(m_clients.size()) >= m_max_clients)
+    {
+        DEB_WARNING() << "Stream client " << address << " refused, too many clients";
+        close(fd);
+        return;
+    }
+    DEB_TRACE() << "Stream client " << address << " connected";
+    _Client *client = new _Client(*this, fd, address);
+    client->start();
+    m_clients.push_back(client);
+    m_nb_clients = m_clients.size();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Streamer::_reapClients(bool all)
+{
+    std::vector<_Client *> dead;
+    AutoMutex lock(m_lock);
+    std::vector<_Client *>::iterator i = m_clients.begin();
+    while (i != m_clients.end())
+    {
+        if (all || (*i)->isDead())
+        {
+            dead.push_back(*i);
+            i = m_clients.erase(i);
+        }
+        else
+            ++i;
+    }
+    m_nb_clients = m_clients.size();
+    lock.unlock();
+
+    for (i = dead.begin(); i != dead.end(); ++i)
+        delete *i;
+}
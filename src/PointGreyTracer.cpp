@@ -0,0 +1,225 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <stdio.h>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "PointGreyTracer.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Tracer::Tracer()
+    : m_active(false)
+    , m_buffer_size(k_DefaultBufferSize)
+{
+    DEB_CONSTRUCTOR();
+    if (pthread_key_create(&m_key, _releaseBuffer))
+        THROW_HW_ERROR(Error) << "Unable to create the trace thread key";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+Tracer::~Tracer()
+{
+    DEB_DESTRUCTOR();
+    pthread_key_delete(m_key);
+    for (std::vector<_Buffer *>::iterator it = m_buffers.begin(); it != m_buffers.end(); ++it)
+        delete *it;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Tracer::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+#ifdef POINTGREY_NO_TRACE
+    if (active)
+        THROW_HW_ERROR(NotSupported) << "Trace points are compiled out";
+#endif
+    m_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Tracer::setBufferSize(int nb_events)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_events);
+    if (nb_events < 1)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_events);
+
+    AutoMutex lock(m_lock);
+    m_buffer_size = nb_events;
+}
+
+//-----------------------------------------------------
+// the rings keep being written, only their start moves
+//-----------------------------------------------------
+void Tracer::clear()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_lock);
+    for (std::vector<_Buffer *>::iterator it = m_buffers.begin(); it != m_buffers.end(); ++it)
+        (*it)->first.store((*it)->nb_written.load(__ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+}
+
+//-----------------------------------------------------
+// only called by the thread owning the ring
+//-----------------------------------------------------
+void Tracer::add(const char *name, int arg, long long start, long long end)
+{
+    _Buffer *buffer = (_Buffer *) pthread_getspecific(m_key);
+    if (!buffer && !(buffer = _getBuffer()))
+        return;
+
+    long long index = buffer->nb_written.load(__ATOMIC_RELAXED);
+    _Event& event = buffer->events[index % buffer->events.size()];
+    event.start = start;
+    event.end = end;
+    event.name = name;
+    event.arg = arg;
+    event.tid = buffer->tid;
+    buffer->nb_written.store(index + 1, __ATOMIC_RELEASE);
+}
+
+//-----------------------------------------------------
+// ring of the calling thread, a released one is reused
+//-----------------------------------------------------
+Tracer::_Buffer *Tracer::_getBuffer()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_lock);
+    _Buffer *buffer = NULL;
+    for (std::vector<_Buffer *>::iterator it = m_buffers.begin(); it != m_buffers.end(); ++it)
+    {
+        if ((*it)->released.load(__ATOMIC_ACQUIRE) && int((*it)->events.size()) == m_buffer_size)
+        {
+            buffer = *it;
+            break;
+        }
+    }
+    if (!buffer)
+    {
+        buffer = new _Buffer;
+        buffer->events.resize(m_buffer_size);
+        m_buffers.push_back(buffer);
+    }
+    buffer->released = false;
+    buffer->tid = syscall(SYS_gettid);
+
+    char name[16] = "";
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    m_thread_names[buffer->tid] = name;
+
+    if (pthread_setspecific(m_key, buffer))
+    {
+        DEB_ERROR() << "Unable to register the trace buffer";
+        buffer->released = true;
+        return NULL;
+    }
+    DEB_TRACE() << "Trace buffer of thread " << buffer->tid << " " << name;
+    return buffer;
+}
+
+//-----------------------------------------------------
+// thread exit
+//-----------------------------------------------------
+void Tracer::_releaseBuffer(void *buffer)
+{
+    ((_Buffer *) buffer)->released.store(true, __ATOMIC_RELEASE);
+}
+
+//-----------------------------------------------------
+// Chrome trace event format, complete events in us
+//-----------------------------------------------------
+void Tracer::dump(const std::string& file_name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(file_name);
+
+    AutoMutex lock(m_lock);
+    FILE *file = fopen(file_name.c_str(), "w");
+    if (!file)
+        THROW_HW_ERROR(Error) << "Unable to open " << file_name;
+
+    int pid = getpid();
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,"
+            "\"args\":{\"name\":\"PointGrey\"}}", pid);
+    for (std::map<int, std::string>::iterator it = m_thread_names.begin();
+         it != m_thread_names.end(); ++it)
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}", pid, it->first, it->second.c_str());
+
+    std::vector<_Event> events;
+    for (std::vector<_Buffer *>::iterator it = m_buffers.begin(); it != m_buffers.end(); ++it)
+    {
+        _Buffer& buffer = **it;
+        long long size = buffer.events.size();
+        long long end = buffer.nb_written.load(__ATOMIC_ACQUIRE);
+        long long begin = std::max(buffer.first.load(__ATOMIC_RELAXED), end - size);
+        events.resize(end - begin);
+        for (long long i = begin; i < end; ++i)
+            events[i - begin] = buffer.events[i % size];
+        // drop what the owner overwrote during the copy, and the slot
+        // of its next event which it may be writing
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        long long valid = buffer.nb_written.load(__ATOMIC_RELAXED) - size + 1;
+        for (long long i = std::max(begin, valid); i < end; ++i)
+        {
+            const _Event& event = events[i - begin];
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"PointGrey\",\"ph\":\"X\","
+                    "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"arg\":%d}}",
+                    event.name, pid, event.tid, event.start * 1e-3,
+                    (event.end - event.start) * 1e-3, event.arg);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    if (fclose(file))
+        THROW_HW_ERROR(Error) << "Unable to write " << file_name;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Tracer::getStats(Stats& stats)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_lock);
+    stats.nb_buffers = m_buffers.size();
+    stats.nb_events = stats.nb_lost = 0;
+    for (std::vector<_Buffer *>::iterator it = m_buffers.begin(); it != m_buffers.end(); ++it)
+    {
+        long long nb_events = (*it)->nb_written.load(__ATOMIC_ACQUIRE) - (*it)->first.load(__ATOMIC_RELAXED);
+        stats.nb_events += nb_events;
+        stats.nb_lost += std::max(0LL, nb_events - (long long) (*it)->events.size());
+    }
+    DEB_RETURN() << DEB_VAR3(stats.nb_buffers, stats.nb_events, stats.nb_lost);
+}
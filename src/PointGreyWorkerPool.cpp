@@ -0,0 +1,155 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include "PointGreyWorkerPool.h"
+
+using namespace lima;
+using namespace lima::PointGrey;
+
+//-----------------------------------------------------
+// _Worker class
+//-----------------------------------------------------
+class WorkerPool::_Worker : public Thread
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "WorkerPool", "_Worker");
+public:
+    // the generation is taken at creation, a job posted before the thread runs is not missed
+    _Worker(WorkerPool& pool, int part)
+        : m_pool(pool), m_part(part), m_generation(pool.m_generation) {}
+    virtual ~_Worker() { join(); }
+protected:
+    virtual void threadFunction();
+private:
+    WorkerPool& m_pool;
+    int m_part;
+    int m_generation;
+};
+
+void WorkerPool::_Worker::threadFunction()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_pool.m_cond.mutex());
+
+    while (true)
+    {
+        while (m_pool.m_generation == m_generation && !m_pool.m_quit)
+            m_pool.m_cond.wait();
+        if (m_pool.m_quit)
+            return;
+
+        m_generation = m_pool.m_generation;
+        Job *job = m_pool.m_job;
+        int nb_parts = m_pool.getNbThreads();
+        lock.unlock();
+
+        job->run(m_part, nb_parts);
+
+        lock.lock();
+        if (--m_pool.m_nb_pending == 0)
+            m_pool.m_cond.broadcast();
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+WorkerPool::WorkerPool()
+    : m_job(NULL)
+    , m_generation(0)
+    , m_nb_pending(0)
+    , m_quit(false)
+{
+    DEB_CONSTRUCTOR();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+WorkerPool::~WorkerPool()
+{
+    DEB_DESTRUCTOR();
+    _stopWorkers();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void WorkerPool::setNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+    if (nb_threads < 1)
+        THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_threads);
+    if (nb_threads == getNbThreads())
+        return;
+
+    _stopWorkers();
+    m_quit = false;
+    for (int part = 1; part < nb_threads; ++part)
+    {
+        _Worker *worker = new _Worker(*this, part);
+        m_workers.push_back(worker);
+        worker->start();
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void WorkerPool::run(Job& job)
+{
+    if (m_workers.empty())
+    {
+        job.run(0, 1);
+        return;
+    }
+
+    AutoMutex lock(m_cond.mutex());
+    m_job = &job;
+    m_nb_pending = m_workers.size();
+    ++m_generation;
+    m_cond.broadcast();
+    lock.unlock();
+
+    job.run(0, getNbThreads());
+
+    lock.lock();
+    while (m_nb_pending > 0)
+        m_cond.wait();
+    m_job = NULL;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void WorkerPool::_stopWorkers()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex lock(m_cond.mutex());
+    m_quit = true;
+    m_cond.broadcast();
+    lock.unlock();
+
+    for (std::vector<_Worker*>::iterator it = m_workers.begin(); it != m_workers.end(); ++it)
+        delete *it;
+    m_workers.clear();
+}